@@ -3,14 +3,55 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <semaphore.h>
 #include <time.h>
 #include <stdbool.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #define BOARD_SIZE 15
-#define NUM_PLAYERS 4
+#define NUM_ARMS 4       // Arms of the board, each with a yard, a start square and a home column
+#define ARM_LENGTH 13    // Ring cells from one start square to the next
 #define MAX_TOKENS 4
-#define PATH_LENGTH 52
+#define PATH_LENGTH (NUM_ARMS * ARM_LENGTH)
+
+// Seats at the table, fixed at build time (-DNUM_PLAYERS=2 or 3). Seat p plays the
+// arm SEAT_ARM(p), so two players face each other, and every per-seat table is a
+// constant expression of the seat: the default four-player build is unchanged.
+#ifndef NUM_PLAYERS
+#define NUM_PLAYERS 4
+#endif
+#if NUM_PLAYERS < 2 || NUM_PLAYERS > NUM_ARMS
+#error "NUM_PLAYERS must be 2, 3 or 4"
+#endif
+#define SEAT_STRIDE (NUM_ARMS / NUM_PLAYERS)
+#define SEAT_ARM(p) ((p) * SEAT_STRIDE)
+#define START_OFFSET(p) (SEAT_ARM(p) * ARM_LENGTH)  // Ring cell where seat p's path starts
+#define TEAM_PLAY (NUM_PLAYERS == 4)                 // Team mode pairs seats 0-1 and 2-3
+#define HOME_COLUMN_LENGTH 6
+#define STUCK_ROLLS 10  // Rolls in a row without a move that end a two-player game
+
+// House-rule variants, off in the standard game
+#define RULE_NO_KILL_GATE 0x01    // Tokens reach home without a kill first
+#define RULE_NO_THREE_SIXES 0x02  // A third six in a row is played like any other
+#define RULE_NO_TEAM_SHARE 0x04   // Teammates neither share kills nor move each other's tokens
 
 pthread_mutex_t board_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t dice_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -19,19 +60,35 @@ sem_t dice_semaphore;
 sem_t board_semaphore;
 pthread_cond_t turn_cond = PTHREAD_COND_INITIALIZER;
 int previous_turn = -1;
+long turn_delay_ticks = 500;         // Clock ticks between the interactive game's rolls, or a hosted table's
+uint8_t game_rules = 0;              // RULE_NO_* variants new games are played with, from --rules
+
+// Direct turn hand-off between the player threads: each player sleeps on its
+// own slot and the seating order is reshuffled at the start of every round
+typedef struct {
+    sem_t slot[NUM_PLAYERS];
+    int order[NUM_PLAYERS];
+    int position;      // Index into order of the player holding the turn
+    int round;
+    long wakeups;      // Times a player thread woke up to check for its turn
+    sem_t game_over;   // Posted by the turn that ends the game
+} TurnScheduler;
+
+TurnScheduler scheduler;
 
 typedef struct {
     int id;
     char symbol;
     char color[10];
-    int tokens[MAX_TOKENS][2];
-    int token_positions[MAX_TOKENS];
+    int token_positions[MAX_TOKENS];  // -1 in the yard, 0..PATH_LENGTH-1 along the player's path, PATH_LENGTH home
     int hit_record;
     int home_tokens;
     pthread_t thread_id;
     bool is_active;
     int num_tokens;
     int rank;
+    int consecutive_sixes;
+    int consecutive_unable_to_move;
 } Player;
 
 typedef struct {
@@ -48,64 +105,562 @@ typedef struct {
     int rank;
 } TeamResult;
 
-Team teams[2];  // For 2 teams of 2 players each
-bool team_mode = false;
+// xoshiro256** generator; every game carries its own stream
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+// Replay log: a 16-byte header per game followed by 1-2 byte events.
+// Recording appends to out; playback walks an in-memory copy of the file.
+typedef struct {
+    FILE* out;
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+    long events;
+    bool diverged;      // Playback no longer matches the log
+    size_t diverged_at; // Byte offset of the first mismatching event
+} Replay;
+
+// Event tags live in the top two bits of the first byte
+#define REPLAY_ROLL 0x00   // Low 3 bits: dice value
+#define REPLAY_TURN 0x40   // Low 2 bits: player whose turn starts
+#define REPLAY_MOVE 0x80   // Bits 3-2: player, bits 1-0: token; second byte: new position (0xFF = yard)
+#define REPLAY_END  0xC0
+#define REPLAY_HEADER_SIZE 16
+
+// Event log: the game narrative as a structured binary stream, appended to a file
+// in compressed blocks. Every game thread writes its own stream into one of two
+// block buffers while a background thread compresses and writes the other.
+#define EVENT_BLOCK_SIZE (64 * 1024)
+
+// Tag in the top four bits, payload in the low four
+#define EV_ROLL    0x10  // Dice value
+#define EV_TURN    0x20  // Player whose turn starts
+#define EV_MOVE    0x30  // Player << 2 | token; then the new position (0xFF for the yard)
+#define EV_HIT     0x40  // Player << 2 | token of the opponent sent to the yard
+#define EV_HOME    0x50  // Player << 2 | token
+#define EV_LOOP    0x60  // Player << 2 | token going round again without a kill
+#define EV_FORFEIT 0x70  // Player losing its turn to a third 6
+#define EV_PASS    0x80  // Player that could not move
+#define EV_GAME    0x90  // Tokens | team mode << 3; then game index (4 bytes) and seed (8 bytes)
+#define EV_END     0xA0  // Then turns (4 bytes), and rank and hits (1 byte each) per player
+
+typedef struct EventLog EventLog;
+
+typedef struct {
+    EventLog* log;
+    uint32_t id;
+    int active;        // Buffer being filled
+    int len;
+    bool queued[2];    // Handed to the flusher and not written yet, under log->lock
+    uint8_t buf[2][EVENT_BLOCK_SIZE];
+} EventStream;
+
+typedef struct Game Game;
+
+// Packed position for search and dedup: 24 bytes, copied with a few loads.
+// Token bytes hold position + 1 (0 yard, 1..PATH_LENGTH on the path, PATH_LENGTH + 1 home).
+typedef struct {
+    uint8_t pos[NUM_PLAYERS][MAX_TOKENS];
+    uint8_t flags[NUM_PLAYERS];  // PACK_ACTIVE | PACK_KILLED | sixes << 2 | rank << 4
+    uint8_t to_move;             // Player whose turn it is
+    uint8_t config;              // Tokens per player, rules << 3, PACK_TEAM_MODE for team games
+    uint8_t pad[2];
+} PackedState;
+
+#define PACK_ACTIVE    0x01
+#define PACK_KILLED    0x02
+#define PACK_SIXES(f)  (((f) >> 2) & 0x03)
+#define PACK_RANK(f)   (((f) >> 4) & 0x07)
+#define PACK_RULES(c)  (((c) >> 3) & 0x07)
+#define PACK_TEAM_MODE 0x80
+#define PACK_POSITIONS (PATH_LENGTH + 2)
+
+// One legal move as the engine would play it
+typedef struct {
+    uint8_t player_id;  // Owner of the token: the mover, or its teammate once the mover has finished
+    uint8_t token_idx;
+    int8_t from;        // Relative position, -1 for the yard
+    int8_t to;          // Relative position after the move, PATH_LENGTH for home
+    uint8_t flags;      // MOVE_* bits
+    uint8_t captured;   // Opponent token sent to the yard (player * MAX_TOKENS + token), if MOVE_CAPTURE
+} Move;
+
+#define MAX_MOVES MAX_TOKENS
+#define MOVE_ENTER      0x01  // Leaves the yard on a 6
+#define MOVE_HOME       0x02  // Reaches home
+#define MOVE_LOOP       0x04  // Passes the end of the path without a kill and goes round again
+#define MOVE_CAPTURE    0x08  // Sends an opponent token back to the yard
+#define MOVE_TEAM_BLOCK 0x10  // Lands on two or more opposing team tokens, which cannot be hit
+#define MOVE_TEAMMATE   0x20  // A finished team player moving its teammate's token
+
+// Undo journal for apply_move/undo_move: per roll, the player status it may change,
+// plus every token placement (own move, capture, teammate move) with its old position
+#define UNDO_MAX_MOVES 64
+#define UNDO_MAX_PLACEMENTS (UNDO_MAX_MOVES * 4)
+
+typedef struct {
+    int8_t player_id;
+    int8_t token_idx;
+    int8_t from;
+} UndoPlacement;
+
+typedef struct {
+    int hit_record;
+    int consecutive_unable_to_move;
+    uint8_t home_tokens;
+    uint8_t consecutive_sixes;
+    uint8_t rank;
+    bool is_active;
+} UndoPlayer;
+
+typedef struct {
+    uint16_t placements;  // Journal height before the roll
+    uint8_t active_players;
+    uint8_t current_rank;
+    bool saved_rng;       // The roll may re-roll for a teammate
+    UndoPlayer players[NUM_PLAYERS];
+    Rng rng;
+} UndoRecord;
+
+typedef struct {
+    int depth;
+    int placed;
+    UndoRecord moves[UNDO_MAX_MOVES];
+    UndoPlacement placements[UNDO_MAX_PLACEMENTS];
+} UndoStack;
+
+#define SEARCH_EXPECTIMAX 0
+#define SEARCH_MCTS       1
+
+// AI seat settings, shared read-only by every game that uses them
+typedef struct {
+    unsigned players;    // Seats played by the search, bit per player id
+    int max_depth;       // Dice rolls to look ahead (expectimax)
+    long node_budget;    // Nodes (expectimax) or playouts (MCTS) per move, 0 for no limit
+    int time_budget_ms;  // Wall clock per move, 0 for no limit
+    int engine;          // SEARCH_EXPECTIMAX or SEARCH_MCTS
+    int threads;         // Threads sharing one MCTS tree
+} SearchConfig;
+
+// Search work done for one game's AI seats
+typedef struct {
+    long moves;      // Decisions that were searched
+    long nodes;
+    long depth_sum;  // Deepest completed iteration (MCTS: longest tree path), summed over moves
+    double seconds;
+} SearchStats;
+
+typedef struct SearchArena SearchArena;
+
+typedef struct Game {
+    Player players[NUM_PLAYERS];
+    Team teams[2];  // For 2 teams of 2 players each
+    bool team_mode;
+    uint8_t rules;  // RULE_NO_* variants in play
+    int num_tokens_per_player;
+    int active_players;
+    int current_rank;
+    int turn_count;
+    uint16_t ring_occupancy[PATH_LENGTH];  // Bit p * MAX_TOKENS + t set while token t of player p sits on the ring cell
+    uint64_t position_hash;                // Zobrist hash of the token positions, kept by place_token
+    bool verbose;   // Print the game narrative
+    bool shared;    // Played by the four player threads: take the board/dice locks
+    Rng rng;
+    int (*next_roll)(Game* game);  // Dice stream behind roll_dice, NULL for rng
+    int (*choose_move)(Game* game, Player* player, int dice_value);  // Token to play, NULL for the first movable
+    Replay* replay;                // Log being recorded or checked, if any
+    const SearchConfig* search;    // AI seats, NULL when every seat plays the first movable token
+    UndoStack* undo;               // Journal of apply_move, NULL outside in-place search
+    EventStream* events;           // Structured event log, NULL when not logging
+    SearchArena* arena;            // Scratch memory kept for searches, NULL to allocate per move
+    SearchStats search_stats;
+} Game;
 
 
 // Global variables
-char board[BOARD_SIZE][BOARD_SIZE];
-Player players[NUM_PLAYERS];
-int num_tokens_per_player;
-int active_players = NUM_PLAYERS;
-int current_rank = 1;
+char board[BOARD_SIZE][BOARD_SIZE];  // Static layout, shared read-only by every game
+uint64_t ring_gate_mask;             // Ring cells that lead into the central path, set up with the board
+uint64_t ring_safe_mask;             // Ring cells marked safe on the board
+Game live_game;                      // The interactive game played by the player threads
+
+// Start-of-game players for each token count, built once with the Zobrist keys,
+// so resetting a game is a single copy
+typedef struct {
+    Player players[NUM_PLAYERS];
+    uint64_t position_hash;
+} FreshPlayers;
+
+FreshPlayers fresh_players[MAX_TOKENS + 1];
+
+// Endgame tablebase: the exact odds of every duel between the last two players
+// of a game without teams, once each has a kill and a single token left. One
+// float per state, indexed by the mover's view: the arms from the mover's to the
+// opponent's, both positions (yard included), both three-sixes counters and both
+// stuck counters. Smaller builds leave the distances no two seats have unused.
+#define TB_POSITIONS (PATH_LENGTH + 1)
+#define TB_STATES ((size_t)(NUM_ARMS - 1) * TB_POSITIONS * TB_POSITIONS * 9 * STUCK_ROLLS * STUCK_ROLLS)
+
+typedef struct {
+    char magic[4];       // "LUDT"
+    uint32_t version;
+    uint64_t states;
+    uint32_t sweeps;     // Value iteration sweeps to converge
+    uint32_t distances;  // Bit d set when duels d arms apart were solved
+    double residual;     // Largest change in the last sweep
+} TablebaseHeader;
+
+typedef struct {
+    const TablebaseHeader* header;  // Mapped file, NULL when no tablebase is loaded
+    const float* values;            // Probability that the mover finishes ahead
+    size_t size;
+} Tablebase;
+
+Tablebase tablebase;
+
+// Zobrist keys, filled once with the board
+uint64_t zobrist_token[NUM_PLAYERS][MAX_TOKENS][PACK_POSITIONS];
+uint64_t zobrist_flags[NUM_PLAYERS][128];
+uint64_t zobrist_turn[NUM_PLAYERS];
+
+#define BOARD_TOP_ROW 3          // Screen row of the first board row
+#define FRAME_BUFFER_SIZE 16384  // Worst case full frame is about 6 KB
+
+// Terminal state for the interactive game: what is on screen and the next frame's bytes
+typedef struct {
+    char buf[FRAME_BUFFER_SIZE];
+    int len;
+    char shown[BOARD_SIZE][BOARD_SIZE];  // Glyph code drawn in each cell
+    bool on_screen;                      // The board has been drawn and the text area set up
+    pthread_mutex_t lock;
+} Renderer;
+
+Renderer renderer = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+#define CONSOLE_SLOTS 1024      // Ring entries, a power of two
+#define CONSOLE_LINE_SIZE 192   // Longest narrative message kept, with its terminator
+
+enum { CONSOLE_TEXT, CONSOLE_FRAME };
+
+// Token positions to draw, copied from the game when a frame is queued
+typedef struct {
+    int8_t pos[NUM_PLAYERS][MAX_TOKENS];
+    int8_t num_tokens[NUM_PLAYERS];
+} BoardSnapshot;
+
+// One ring entry. seq is the slot's ticket: it equals the write index when the
+// slot is free and the write index + 1 once the message in it is complete.
+typedef struct {
+    atomic_size_t seq;
+    int kind;
+    union {
+        char text[CONSOLE_LINE_SIZE];
+        BoardSnapshot board;
+    };
+} ConsoleSlot;
+
+// Multi-producer ring between the player threads and the renderer thread. Producers
+// claim a slot with one compare-and-swap and never wait: a full ring drops the
+// message. The renderer draws only the newest frame of each batch it drains.
+typedef struct {
+    ConsoleSlot slots[CONSOLE_SLOTS];
+    _Alignas(64) atomic_size_t head;  // Next slot to claim, shared by the producers
+    _Alignas(64) size_t tail;         // Next slot to read, renderer thread only
+    sem_t ready;                      // Posted once per queued message
+    atomic_bool running;
+    pthread_t thread_id;
+    atomic_long lines_dropped;        // Narrative lost to a full ring
+    atomic_long frames_dropped;       // Frames lost to a full ring or drawn over before shown
+    long frames_drawn;
+} Console;
+
+Console console;
+
+// Game narrative output, silenced in headless simulation
+#define GAME_LOG(game, ...) do { if((game)->verbose) console_printf(__VA_ARGS__); } while(0)
+
+// Append one event to the game's event stream, if it has one
+#define GAME_EVENT(game, ...) do { \
+    if((game)->events) { \
+        const uint8_t event_bytes_[] = { __VA_ARGS__ }; \
+        event_put((game)->events, event_bytes_, sizeof(event_bytes_)); \
+    } \
+} while(0)
+
+// Game clock. Pacing is counted in ticks, a millisecond each at 1x speed, and every
+// wait sleeps to an absolute CLOCK_MONOTONIC deadline, so waits neither drift nor
+// depend on how long the work before them took.
+#define CLOCK_TICK_NS 1000000L
+
+typedef struct {
+    double speed;   // Tick rate: 1 real time, 4 four times faster, 0.25 slow motion, 0 unthrottled
+    long beat_ns;   // Deadline of the last paced step
+} GameClock;
+
+GameClock game_clock = { .speed = 1.0 };
+
+static inline long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Nanoseconds that ticks last at the clock's speed, 0 when unthrottled
+static inline long clock_span(const GameClock* clock, long ticks) {
+    if(clock->speed <= 0.0 || ticks <= 0) return 0;
+    return (long)(ticks * CLOCK_TICK_NS / clock->speed);
+}
+
+static inline void clock_sleep_until(long deadline_ns) {
+    struct timespec ts = { deadline_ns / 1000000000L, deadline_ns % 1000000000L };
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+// Start the beat now
+static inline void clock_start(GameClock* clock) {
+    clock->beat_ns = monotonic_ns();
+}
+
+// Hold the caller until ticks after the previous paced step. The deadline counts
+// from that step's deadline, so rendering and search come out of the pause; a
+// caller that is already late takes the step at once and the beat restarts there.
+static inline void clock_pace(GameClock* clock, long ticks) {
+    long span = clock_span(clock, ticks);
+    if(span == 0) return;
+    long now = monotonic_ns();
+    clock->beat_ns += span;
+    if(clock->beat_ns <= now) {
+        clock->beat_ns = now;
+        return;
+    }
+    clock_sleep_until(clock->beat_ns);
+}
+
+// Hold the caller for ticks from now, outside the beat
+static inline void clock_wait(const GameClock* clock, long ticks) {
+    long span = clock_span(clock, ticks);
+    if(span > 0) clock_sleep_until(monotonic_ns() + span);
+}
+
+// Build with -DLUDO_INSTRUMENT to time the interactive game's turns and count its
+// lock traffic; the JSON report follows the Game Over summary. Without it every
+// hook below is the plain call or nothing at all.
+#ifdef LUDO_INSTRUMENT
+
+#define LATENCY_BUCKETS 40  // Bucket b counts latencies in [2^(b-1), 2^b) ns
+
+enum { LAT_TURN, LAT_ROLL, LAT_MOVEGEN, LAT_HITS, LAT_RENDER, NUM_LATENCIES };
+enum { LOCK_BOARD, LOCK_DICE, LOCK_TURN, LOCK_DICE_SEM, LOCK_BOARD_SEM, NUM_LOCKS };
+
+typedef struct {
+    long count;
+    long total_ns;
+    long max_ns;
+    long buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+typedef struct {
+    long acquisitions;
+    long contended;  // Acquisitions that found the lock taken
+    long wait_ns;
+} LockCounters;
+
+// Latencies are recorded by the thread holding the turn and lock counters while
+// holding the lock they count, so plain longs are enough
+typedef struct {
+    LatencyHistogram latency[NUM_LATENCIES];
+    LockCounters locks[NUM_LOCKS];
+    long cond_wakeups;    // Returns from pthread_cond_wait in the broadcast scheduler
+    long wasted_wakeups;  // Of those, wakeups of a player whose turn it was not
+    long paused_ns;       // Turn delay sleeps, left out of turn latency
+} Instrumentation;
+
+Instrumentation instrumentation;
+
+// Only the shared game is measured; headless games pass 0 and record nothing
+static inline long instr_clock(Game* game) {
+    return game->shared ? monotonic_ns() : 0;
+}
+
+static inline void instr_record(int which, long start, long excluded_ns) {
+    if(start == 0) return;
+    LatencyHistogram* h = &instrumentation.latency[which];
+    long ns = monotonic_ns() - start - excluded_ns;
+    int bucket = ns > 0 ? 64 - __builtin_clzl((unsigned long)ns) : 0;
+    
+    h->count++;
+    h->total_ns += ns;
+    if(ns > h->max_ns) h->max_ns = ns;
+    h->buckets[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1]++;
+}
+
+static inline void counted_mutex_lock(pthread_mutex_t* mutex, int which) {
+    LockCounters* c = &instrumentation.locks[which];
+    if(pthread_mutex_trylock(mutex) != 0) {
+        long start = monotonic_ns();
+        pthread_mutex_lock(mutex);
+        c->wait_ns += monotonic_ns() - start;
+        c->contended++;
+    }
+    c->acquisitions++;
+}
+
+static inline void counted_sem_wait(sem_t* sem, int which) {
+    LockCounters* c = &instrumentation.locks[which];
+    if(sem_trywait(sem) != 0) {
+        long start = monotonic_ns();
+        while(sem_wait(sem) != 0);
+        c->wait_ns += monotonic_ns() - start;
+        c->contended++;
+    }
+    c->acquisitions++;
+}
+
+static inline void paused_pace(long ticks) {
+    long start = monotonic_ns();
+    clock_pace(&game_clock, ticks);
+    instrumentation.paused_ns += monotonic_ns() - start;
+}
+
+#define LOCK_MUTEX(mutex, which) counted_mutex_lock((mutex), (which))
+#define WAIT_SEM(sem, which) counted_sem_wait((sem), (which))
+#define TURN_PACE(ticks) paused_pace(ticks)
+#define INSTR_TIMER(name, game) long name = instr_clock(game)
+#define INSTR_RECORD(name, which) instr_record((which), (name), 0)
+#define INSTR_TURN_BEGIN(game) long instr_turn_start = instr_clock(game); \
+                               long instr_turn_paused = instrumentation.paused_ns
+#define INSTR_TURN_END() instr_record(LAT_TURN, instr_turn_start, instrumentation.paused_ns - instr_turn_paused)
+#define INSTR_COUNT(counter) (instrumentation.counter++)
+
+#else
+
+#define LOCK_MUTEX(mutex, which) pthread_mutex_lock(mutex)
+#define WAIT_SEM(sem, which) sem_wait(sem)
+#define TURN_PACE(ticks) clock_pace(&game_clock, (ticks))
+#define INSTR_TIMER(name, game) do { } while(0)
+#define INSTR_RECORD(name, which) do { } while(0)
+#define INSTR_TURN_BEGIN(game) do { } while(0)
+#define INSTR_TURN_END() do { } while(0)
+#define INSTR_COUNT(counter) do { } while(0)
+
+#endif
+
+// Only the interactive game is touched by several threads at once
+static inline void lock_board(Game* game) { if(game->shared) LOCK_MUTEX(&board_mutex, LOCK_BOARD); }
+static inline void unlock_board(Game* game) { if(game->shared) pthread_mutex_unlock(&board_mutex); }
+static inline void lock_dice(Game* game) { if(game->shared) LOCK_MUTEX(&dice_mutex, LOCK_DICE); }
+static inline void unlock_dice(Game* game) { if(game->shared) pthread_mutex_unlock(&dice_mutex); }
 
 // Function declarations
 void initialize_board(void);
-void initialize_players(void);
-bool are_teammates(int player1_id, int player2_id);
-bool teammate_finished(Player* player);
-void display_board(void);
-int roll_dice(void);
-bool is_safe_square(int row, int col);
-bool has_killed_token(Player* player);
-bool can_enter_home(Player* player);
-bool is_token_home(Player* player, int token_idx);
-bool can_move_token(Player* player, int token_idx, int steps);
-void check_hits(Player* player, int new_row, int new_col);
-void move_token(Player* player, int token_idx, int steps);
-bool check_win(Player* player);
+void initialize_players(Game* game);
+void reset_players(Game* game);
+void yard_cell(int player_id, int token_idx, int* row, int* col);
+void token_cell(Player* player, int token_idx, int* row, int* col);
+void position_cell(int player_id, int token_idx, int pos, int* row, int* col);
+void place_token(Game* game, Player* player, int token_idx, int new_pos);
+void initialize_zobrist(void);
+uint64_t pack_game(Game* game, int to_move, PackedState* out);
+int unpack_game(const PackedState* state, Game* game);
+uint64_t zobrist_hash(const PackedState* state);
+void packed_set_token(PackedState* state, uint64_t* hash, int player_id, int token_idx, int new_pos);
+void packed_set_flags(PackedState* state, uint64_t* hash, int player_id, uint8_t flags);
+void packed_set_turn(PackedState* state, uint64_t* hash, int to_move);
+void reset_game(Game* game, uint64_t seed);
+void setup_teams(Game* game);
+bool are_teammates(const Game* game, int player1_id, int player2_id);
+bool teammate_finished(Game* game, Player* player);
+void snapshot_board(Game* game, BoardSnapshot* snap);
+void render_snapshot(Renderer* r, const BoardSnapshot* snap);
+void render_frame(Renderer* r, Game* game);
+void display_board(Game* game);
+void close_display(void);
+void console_start(void);
+void console_stop(void);
+void console_printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+uint64_t splitmix64(uint64_t* x);
+void rng_seed(Rng* rng, uint64_t seed);
+int roll_dice(Game* game);
+void replay_event(Replay* r, int tag, int arg);
+void event_put(EventStream* s, const uint8_t* bytes, int len);
+void event_begin_game(Game* game, int game_index, uint64_t seed);
+void event_end_game(Game* game);
+void replay_begin_game(Replay* r, Game* game, uint64_t seed);
+void record_turn(Game* game, int player_id);
+void record_game_end(Game* game);
+int replay_roll(Game* game);
+void replay_move(Game* game, int player_id, int token_idx, int new_pos);
+int run_replay(const char* path, bool quiet);
+int run_analysis(int num_tokens, bool team_mode, uint8_t rules, int num_workers);
+bool tablebase_probe(const Game* game, int player_id, double* win);
+bool is_safe_square(const Game* game, int cell);
+bool has_killed_token(const Player* player);
+bool can_enter_home(const Player* player);
+bool can_pass_gate(const Game* game, const Player* player);
+void format_rules(uint8_t rules, char* out, size_t size);
+bool is_token_home(const Player* player, int token_idx);
+bool can_move_token(const Game* game, const Player* player, int token_idx, int steps);
+void check_hits(Game* game, Player* player, int cell);
+void move_token(Game* game, Player* player, int token_idx, int steps);
+int generate_moves(const Game* game, int player_id, int dice_value, Move moves[MAX_MOVES]);
+bool check_win(Game* game, Player* player);
+int movable_tokens(Game* game, Player* player, int dice_value, int tokens[MAX_TOKENS]);
+int first_movable_token(Game* game, Player* player, int dice_value);
+bool forfeits_turn(Game* game, Player* player, int dice_value);
+bool play_roll(Game* game, Player* player, int dice_value);
+bool play_token(Game* game, Player* player, int dice_value, int token_idx);
+bool apply_move(Game* game, Player* player, int dice_value, int token_idx, bool count_six);
+void undo_move(Game* game);
+void undo_placements(Game* game, int height);
+void print_search_stats(const SearchConfig* config, SearchStats* stats);
+int search_move(Game* game, Player* player, int dice_value);
+void search_arena_release(SearchArena* arena);
+int replay_choose(Game* game, Player* player, int dice_value);
+void play_game(Game* game, int max_turns);
+void deal_turn_order(Game* game, int order[NUM_PLAYERS]);
+bool batch_kernel_available(void);
+void take_turn(Game* game, Player* player);
 void* player_turn(void* arg);
+void* player_turn_broadcast(void* arg);
 
 
 // Add this function to initialize teams
-void initialize_teams() {
+void initialize_teams(Game* game) {
     char choice;
+    if(!TEAM_PLAY) return;
     printf("Do you want to play in team mode? (y/n): ");
     scanf(" %c", &choice);
     
     if(choice == 'y' || choice == 'Y') {
-        team_mode = true;
         printf("\nForming teams...\n");
-        teams[0].player1_id = 0;  // Red
-        teams[0].player2_id = 1;  // Yellow
-        teams[0].has_team = true;
+        setup_teams(game);
         
-        teams[1].player1_id = 2;  // Green
-        teams[1].player2_id = 3;  // Blue
-        teams[1].has_team = true;
-        
-        printf("Team 1: %s and %s\n", players[0].color, players[1].color);
-        printf("Team 2: %s and %s\n", players[2].color, players[3].color);
+        for(int i = 0; i < 2; i++) {
+            printf("Team %d: %s and %s\n", i + 1, game->players[game->teams[i].player1_id].color,
+                   game->players[game->teams[i].player2_id].color);
+        }
     }
 }
 
+void setup_teams(Game* game) {
+    game->team_mode = true;
+    game->teams[0].player1_id = 0;  // Red
+    game->teams[0].player2_id = 1;  // Yellow
+    game->teams[0].has_team = true;
+    
+    game->teams[1].player1_id = 2;  // Green
+    game->teams[1].player2_id = 3;  // Blue
+    game->teams[1].has_team = true;
+}
+
 // Add function to check if two players are teammates
-bool are_teammates(int player1_id, int player2_id) {
-    if(!team_mode) return false;
+bool are_teammates(const Game* game, int player1_id, int player2_id) {
+    if(!game->team_mode) return false;
     
     for(int i = 0; i < 2; i++) {
-        if((teams[i].player1_id == player1_id && teams[i].player2_id == player2_id) ||
-           (teams[i].player1_id == player2_id && teams[i].player2_id == player1_id)) {
+        if((game->teams[i].player1_id == player1_id && game->teams[i].player2_id == player2_id) ||
+           (game->teams[i].player1_id == player2_id && game->teams[i].player2_id == player1_id)) {
             return true;
         }
     }
@@ -113,67 +668,85 @@ bool are_teammates(int player1_id, int player2_id) {
 }
 
 // Add function to check if a player's teammate has finished
-bool teammate_finished(Player* player) {
-    if(!team_mode) return false;
+bool teammate_finished(Game* game, Player* player) {
+    if(!game->team_mode) return false;
     
     for(int i = 0; i < 2; i++) {
-        if(teams[i].player1_id == player->id) {
-            return players[teams[i].player2_id].home_tokens == players[teams[i].player2_id].num_tokens;
+        if(game->teams[i].player1_id == player->id) {
+            return game->players[game->teams[i].player2_id].home_tokens == game->players[game->teams[i].player2_id].num_tokens;
         }
-        if(teams[i].player2_id == player->id) {
-            return players[teams[i].player1_id].home_tokens == players[teams[i].player1_id].num_tokens;
+        if(game->teams[i].player2_id == player->id) {
+            return game->players[game->teams[i].player1_id].home_tokens == game->players[game->teams[i].player1_id].num_tokens;
         }
     }
     return false;
 }
 
 
-const int path_coords[4][PATH_LENGTH][2] = {
-    // Red player path (starts at 6,1)
-    {{6,1}, {6,2}, {6,3}, {6,4}, {6,5}, {5,6}, {4,6}, {3,6}, {2,6}, {1,6}, {0,6},
-     {0,7}, {0,8}, {1,8}, {2,8}, {3,8}, {4,8}, {5,8}, {6,9}, {6,10}, {6,11}, {6,12}, {6,13}, {6,14},
-     {7,14}, {8,14}, {8,13}, {8,12}, {8,11}, {8,10}, {8,9}, {9,8}, {10,8}, {11,8}, {12,8}, {13,8}, {14,8},
-     {14,7}, {14,6}, {13,6}, {12,6}, {11,6}, {10,6}, {9,6}, {8,5}, {8,4}, {8,3}, {8,2}, {8,1}, {8,0}, {7,0}, {6,0}},
-    
-    // Yellow player path (starts at 1,8)
-    {{1,8}, {2,8}, {3,8}, {4,8}, {5,8}, {6,9}, {6,10}, {6,11}, {6,12}, {6,13}, {6,14},
-     {7,14}, {8,14}, {8,13}, {8,12}, {8,11}, {8,10}, {8,9}, {9,8}, {10,8}, {11,8}, {12,8}, {13,8}, {14,8},
-     {14,7}, {14,6}, {13,6}, {12,6}, {11,6}, {10,6}, {9,6}, {8,5}, {8,4}, {8,3}, {8,2}, {8,1}, {8,0}, {7,0}, {6,0},
-     {6,1}, {6,2}, {6,3}, {6,4}, {6,5}, {5,6}, {4,6}, {3,6}, {2,6}, {1,6}, {0,6}, {0,7}, {0,8}},
-    
-    // Green player path (starts at 8,13)
-{{8,13}, {8,12}, {8,11}, {8,10}, {8,9}, {9,8}, {10,8}, {11,8}, {12,8}, {13,8}, {14,8},
-{14,7}, {14,6}, {13,6}, {12,6}, {11,6}, {10,6}, {9,6}, {8,5}, {8,4}, {8,3}, {8,2}, {8,1}, {8,0},
-{7,0}, {6,0}, {6,1}, {6,2}, {6,3}, {6,4}, {6,5}, {5,6}, {4,6}, {3,6}, {2,6}, {1,6}, {0,6},
-{0,7}, {0,8}, {1,8}, {2,8}, {3,8}, {4,8}, {5,8}, {6,9}, {6,10}, {6,11}, {6,12}, {6,13}, {6,14}, {7,14}, {8,14}},
+// The 52-cell loop shared by every player, indexed from Red's start square
+const int ring_coords[PATH_LENGTH][2] = {
+    {6,1}, {6,2}, {6,3}, {6,4}, {6,5}, {5,6}, {4,6}, {3,6}, {2,6}, {1,6}, {0,6},
+    {0,7}, {0,8}, {1,8}, {2,8}, {3,8}, {4,8}, {5,8}, {6,9}, {6,10}, {6,11}, {6,12}, {6,13}, {6,14},
+    {7,14}, {8,14}, {8,13}, {8,12}, {8,11}, {8,10}, {8,9}, {9,8}, {10,8}, {11,8}, {12,8}, {13,8}, {14,8},
+    {14,7}, {14,6}, {13,6}, {12,6}, {11,6}, {10,6}, {9,6}, {8,5}, {8,4}, {8,3}, {8,2}, {8,1}, {8,0}, {7,0}, {6,0}
+};
+
+// Arm colours and start squares: Red (6,1), Yellow (1,8), Green (8,13), Blue (13,6)
+const char* const arm_colors[NUM_ARMS] = {"Red", "Yellow", "Green", "Blue"};
+const char arm_symbols[NUM_ARMS] = {'R', 'Y', 'G', 'B'};
 
-// Blue player path (starts at 13,6)
-{{13,6}, {12,6}, {11,6}, {10,6}, {9,6}, {8,5}, {8,4}, {8,3}, {8,2}, {8,1}, {8,0},
-{7,0}, {6,0}, {6,1}, {6,2}, {6,3}, {6,4}, {6,5}, {5,6}, {4,6}, {3,6}, {2,6}, {1,6}, {0,6},
-{0,7}, {0,8}, {1,8}, {2,8}, {3,8}, {4,8}, {5,8}, {6,9}, {6,10}, {6,11}, {6,12}, {6,13}, {6,14},
-{7,14}, {8,14}, {8,13}, {8,12}, {8,11}, {8,10}, {8,9}, {9,8}, {10,8}, {11,8}, {12,8}, {13,8}, {14,8}, {14,7}, {14,6}}
+// Each arm's home column, from the ring towards the centre; finished tokens are drawn here
+const int home_column[NUM_ARMS][HOME_COLUMN_LENGTH][2] = {
+    {{7,1}, {7,2}, {7,3}, {7,4}, {7,5}, {7,6}},       // Red
+    {{1,7}, {2,7}, {3,7}, {4,7}, {5,7}, {6,7}},       // Yellow
+    {{7,13}, {7,12}, {7,11}, {7,10}, {7,9}, {7,8}},   // Green
+    {{13,7}, {12,7}, {11,7}, {10,7}, {9,7}, {8,7}}    // Blue
 };
 
+// Ring cell of a position along a player's path
+static inline int ring_cell(int player_id, int pos) {
+    int cell = pos + START_OFFSET(player_id);
+    return cell >= PATH_LENGTH ? cell - PATH_LENGTH : cell;
+}
+
 // Add new function to check if a player has killed at least one token
-bool has_killed_token(Player* player) {
+bool has_killed_token(const Player* player) {
     return player->hit_record > 0;
 }
 
-bool team_has_killed(Player* player) {
-    if (!team_mode) return has_killed_token(player);
+bool team_has_killed(const Game* game, const Player* player) {
+    if (!game->team_mode || (game->rules & RULE_NO_TEAM_SHARE)) return has_killed_token(player);
     
     for (int i = 0; i < 2; i++) {
-        if (teams[i].player1_id == player->id || teams[i].player2_id == player->id) {
-            int teammate_id = (teams[i].player1_id == player->id) ? 
-                             teams[i].player2_id : teams[i].player1_id;
-            return (player->hit_record > 0 || players[teammate_id].hit_record > 0);
+        if (game->teams[i].player1_id == player->id || game->teams[i].player2_id == player->id) {
+            int teammate_id = (game->teams[i].player1_id == player->id) ? 
+                             game->teams[i].player2_id : game->teams[i].player1_id;
+            return (player->hit_record > 0 || game->players[teammate_id].hit_record > 0);
         }
     }
     return false;
 }
 
+// A kill opens the central path and home, unless the kill gate is off
+bool can_pass_gate(const Game* game, const Player* player) {
+    return (game->rules & RULE_NO_KILL_GATE) || team_has_killed(game, player);
+}
+
+// Names of the RULE_NO_* bits, lowest first
+const char* rule_names[] = {"no-kill-gate", "no-three-sixes", "no-team-share"};
+
+// Rule variants as a comma separated list, "standard" for none
+void format_rules(uint8_t rules, char* out, size_t size) {
+    snprintf(out, size, "%s", rules ? "" : "standard");
+    for(int i = 0; i < 3; i++) {
+        if(!((rules >> i) & 1)) continue;
+        size_t len = strlen(out);
+        snprintf(out + len, size - len, "%s%s", len ? "," : "", rule_names[i]);
+    }
+}
+
 void initialize_board() {
-    pthread_mutex_lock(&board_mutex);
+    LOCK_MUTEX(&board_mutex, LOCK_BOARD);
     
     // Clear the board first
     for(int i = 0; i < BOARD_SIZE; i++) {
@@ -238,520 +811,5784 @@ void initialize_board() {
         board[green_safe[i][0]][green_safe[i][1]] = 'g';
     }
     
+    // Precompute the ring cells the movement rules care about
+    ring_gate_mask = 0;
+    ring_safe_mask = 0;
+    for(int i = 0; i < PATH_LENGTH; i++) {
+        int row = ring_coords[i][0];
+        int col = ring_coords[i][1];
+        if(row == 7 || col == 7) ring_gate_mask |= 1ULL << i;
+        if(board[row][col] == 'S') ring_safe_mask |= 1ULL << i;
+    }
+    
+    initialize_zobrist();
+    
     pthread_mutex_unlock(&board_mutex);
 }
 
 
-void initialize_players() {
+void initialize_players(Game* game) {
     printf("Enter number of tokens per player (1-4): ");
-    scanf("%d", &num_tokens_per_player);
+    scanf("%d", &game->num_tokens_per_player);
     
-    if(num_tokens_per_player < 1 || num_tokens_per_player > 4) {
+    if(game->num_tokens_per_player < 1 || game->num_tokens_per_player > 4) {
         printf("Invalid number of tokens. Setting to default (4)\n");
-        num_tokens_per_player = 4;
+        game->num_tokens_per_player = 4;
     }
     
-    char colors[4][10] = {"Red", "Yellow", "Green", "Blue"};
-    char symbols[4] = {'R', 'Y', 'G', 'B'};
-    
-    for(int i = 0; i < NUM_PLAYERS; i++) {
-        players[i].id = i;
-        players[i].symbol = symbols[i];
-        strcpy(players[i].color, colors[i]);
-        players[i].hit_record = 0;
-        players[i].home_tokens = 0;
-        players[i].is_active = true;
-        players[i].num_tokens = num_tokens_per_player;
-        players[i].rank = 0;
-        
-        for(int j = 0; j < num_tokens_per_player; j++) {
-            players[i].token_positions[j] = -1;
-            
-            switch(i) {
-                case 0:
-                    players[i].tokens[j][0] = 2 + (j/2);
-                    players[i].tokens[j][1] = 2 + (j%2);
-                    break;
-                case 1:
-                    players[i].tokens[j][0] = 2 + (j/2);
-                    players[i].tokens[j][1] = 11 + (j%2);
-                    break;
-                case 2:
-                    players[i].tokens[j][0] = 11 + (j/2);
-                    players[i].tokens[j][1] = 11 + (j%2);
-                    break;
-                case 3:
-                    players[i].tokens[j][0] = 11 + (j/2);
-                    players[i].tokens[j][1] = 2 + (j%2);
-                    break;
-            }
-        }
-    }
+    reset_players(game);
 }
 
-void display_board() {
-    
-    pthread_mutex_lock(&board_mutex);
-    system("clear");
-    
-    printf("\n  ");
-    for(int j = 0; j < BOARD_SIZE; j++) {
-       // printf(" %2d", j);
-    }
-    printf("\n");
-    
-    for(int i = 0; i < BOARD_SIZE; i++) {
-        //printf("%2d ", i);
-        for(int j = 0; j < BOARD_SIZE; j++) {
-            bool token_present = false;
-            for(int p = 0; p < NUM_PLAYERS; p++) {
-                for(int t = 0; t < players[p].num_tokens; t++) {
-                    if(players[p].tokens[t][0] == i && players[p].tokens[t][1] == j) {
-                        printf("\033[1;%dm%c \033[0m", 
-                        (p == 0) ? 31 :  // Red
-                        (p == 1) ? 33 :  // Yellow
-                        (p == 2) ? 32 :  // Green
-                        34,              // Blue
-                        players[p].symbol);
-                        token_present = true;
-                        break;
-                    }
-                }
-                if(token_present) break;
-            }
-            
-            if(!token_present) {
-                switch(board[i][j]) {
-                    case 'R': printf("\033[1;31m█ \033[0m"); break;
-                    case 'Y': printf("\033[1;33m█ \033[0m"); break;
-                    case 'G': printf("\033[1;32m█ \033[0m"); break;
-                    case 'B': printf("\033[1;34m█ \033[0m"); break;
-                    case 'r': printf("\033[1;31m• \033[0m"); break;  // Red dot
-                    case 'y': printf("\033[1;33m• \033[0m"); break;  // Yellow dot
-                    case 'g': printf("\033[1;32m• \033[0m"); break;  // Green dot
-                    case 'b': printf("\033[1;34m• \033[0m"); break;  // Blue dot
-                    case 'S': printf("\033[1;37m* \033[0m"); break;
-                    default: printf("□ ");
-                }
-            }
-        }
-        printf("\n");
-    }
-    
-    pthread_mutex_unlock(&board_mutex);
+// Start a fresh game with the current token and team settings
+void reset_game(Game* game, uint64_t seed) {
+    reset_players(game);
+    game->active_players = NUM_PLAYERS;
+    game->current_rank = 1;
+    game->turn_count = 0;
+    game->rules = game_rules;
+    rng_seed(&game->rng, seed);
 }
 
-int roll_dice() {
-    pthread_mutex_lock(&dice_mutex);
-    int result = (rand() % 6) + 1;
-    pthread_mutex_unlock(&dice_mutex);
-    return result;
+// Put every token back in its yard. Copies the start-of-game players built by
+// initialize_zobrist; thread ids are cleared, so reset before starting threads.
+void reset_players(Game* game) {
+    const FreshPlayers* fresh = &fresh_players[game->num_tokens_per_player];
+    memcpy(game->players, fresh->players, sizeof(game->players));
+    memset(game->ring_occupancy, 0, sizeof(game->ring_occupancy));
+    game->position_hash = fresh->position_hash;
 }
 
-bool is_safe_square(int row, int col) {
-    if(board[row][col] == 'S') return true;
-    
-    for(int p = 0; p < NUM_PLAYERS; p++) {
-        for(int t = 0; t < players[p].num_tokens; t++) {
-            if(players[p].tokens[t][0] == row && players[p].tokens[t][1] == col) {
-                return false;
-            }
-        }
+// Home yard cell where a token waits before entering the path
+void yard_cell(int player_id, int token_idx, int* row, int* col) {
+    switch(SEAT_ARM(player_id)) {
+        case 0:
+            *row = 2 + (token_idx/2);
+            *col = 2 + (token_idx%2);
+            break;
+        case 1:
+            *row = 2 + (token_idx/2);
+            *col = 11 + (token_idx%2);
+            break;
+        case 2:
+            *row = 11 + (token_idx/2);
+            *col = 11 + (token_idx%2);
+            break;
+        case 3:
+            *row = 11 + (token_idx/2);
+            *col = 2 + (token_idx%2);
+            break;
     }
-    return true;
 }
 
-bool can_enter_home(Player* player) {
-    return player->hit_record > 0;
+// Board cell of a token at path position pos
+void position_cell(int player_id, int token_idx, int pos, int* row, int* col) {
+    if(pos < 0) {
+        yard_cell(player_id, token_idx, row, col);
+    } else if(pos >= PATH_LENGTH) {
+        *row = home_column[SEAT_ARM(player_id)][HOME_COLUMN_LENGTH - 1 - token_idx][0];
+        *col = home_column[SEAT_ARM(player_id)][HOME_COLUMN_LENGTH - 1 - token_idx][1];
+    } else {
+        int cell = ring_cell(player_id, pos);
+        *row = ring_coords[cell][0];
+        *col = ring_coords[cell][1];
+    }
 }
 
-bool is_token_home(Player* player, int token_idx) {
-    int pos = player->token_positions[token_idx];
-    return pos >= PATH_LENGTH;
+// Board cell a token is drawn on
+void token_cell(Player* player, int token_idx, int* row, int* col) {
+    position_cell(player->id, token_idx, player->token_positions[token_idx], row, col);
 }
 
-bool can_move_token(Player* player, int token_idx, int steps) {
-    if(is_token_home(player, token_idx)) return false;
-    
+// Set a token's path position, keeping the ring occupancy index in step
+void place_token(Game* game, Player* player, int token_idx, int new_pos) {
+    uint16_t bit = 1u << (player->id * MAX_TOKENS + token_idx);
     int curr_pos = player->token_positions[token_idx];
-    int new_pos = curr_pos + steps;
     
-    // If token would move beyond PATH_LENGTH
-    if(new_pos >= PATH_LENGTH) {
-        if(team_mode) {
-            // In team mode, check if any team member has killed
-            if(!team_has_killed(player)) {
-                new_pos = new_pos % PATH_LENGTH;  // Loop back if no team kills
-            } else {
-                return new_pos == PATH_LENGTH;  // Can enter home if team has kills
-            }
-        } else {
-            // Single player mode logic remains the same
-            if(!has_killed_token(player)) {
-                new_pos = new_pos % PATH_LENGTH;
-            } else {
-                return new_pos == PATH_LENGTH;
-            }
-        }
+    if(game->replay) replay_move(game, player->id, token_idx, new_pos);
+    GAME_EVENT(game, EV_MOVE | (player->id << 2) | token_idx, new_pos < 0 ? 0xFF : new_pos);
+    if(game->undo) {
+        UndoPlacement* entry = &game->undo->placements[game->undo->placed++];
+        entry->player_id = (int8_t)player->id;
+        entry->token_idx = (int8_t)token_idx;
+        entry->from = (int8_t)curr_pos;
     }
     
-    // Get coordinates for new position
-    int new_row = path_coords[player->id][new_pos][0];
-    int new_col = path_coords[player->id][new_pos][1];
-    
-    // Check for central path access
-    bool entering_central_path = (new_row == 7 || new_col == 7) && 
-                               (curr_pos == -1 || path_coords[player->id][curr_pos][0] != 7 && 
-                                path_coords[player->id][curr_pos][1] != 7);
+    game->position_hash ^= zobrist_token[player->id][token_idx][curr_pos + 1] ^
+                           zobrist_token[player->id][token_idx][new_pos + 1];
     
-    if(team_mode && entering_central_path && !team_has_killed(player)) {
-        return false;  // Team needs at least one kill to enter central path
-    } else if(!team_mode && entering_central_path && !has_killed_token(player)) {
-        return false;  // Individual needs kill in single player mode
+    if(curr_pos >= 0 && curr_pos < PATH_LENGTH) {
+        game->ring_occupancy[ring_cell(player->id, curr_pos)] &= ~bit;
     }
+    if(new_pos >= 0 && new_pos < PATH_LENGTH) {
+        game->ring_occupancy[ring_cell(player->id, new_pos)] |= bit;
+    }
+    player->token_positions[token_idx] = new_pos;
+}
+
+// Fixed keys so hashes are stable across runs and processes
+void initialize_zobrist(void) {
+    uint64_t x = 0x5EED2024ULL;
     
-    // Rest of the function remains the same
-    if(board[new_row][new_col] == 'S') {
-        for(int p = 0; p < NUM_PLAYERS; p++) {
-            for(int t = 0; t < players[p].num_tokens; t++) {
-                if(players[p].tokens[t][0] == new_row && 
-                   players[p].tokens[t][1] == new_col && 
-                   players[p].token_positions[t] >= 0) {
-                    return false;
-                }
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        for(int t = 0; t < MAX_TOKENS; t++) {
+            for(int i = 0; i < PACK_POSITIONS; i++) {
+                zobrist_token[p][t][i] = splitmix64(&x);
             }
         }
+        for(int f = 0; f < 128; f++) {
+            zobrist_flags[p][f] = splitmix64(&x);
+        }
+        zobrist_turn[p] = splitmix64(&x);
     }
     
-    return true;
+    for(int n = 0; n <= MAX_TOKENS; n++) {
+        FreshPlayers* fresh = &fresh_players[n];
+        memset(fresh, 0, sizeof(*fresh));
+        for(int i = 0; i < NUM_PLAYERS; i++) {
+            Player* player = &fresh->players[i];
+            player->id = i;
+            player->symbol = arm_symbols[SEAT_ARM(i)];
+            strcpy(player->color, arm_colors[SEAT_ARM(i)]);
+            player->is_active = true;
+            player->num_tokens = n;
+            for(int j = 0; j < MAX_TOKENS; j++) {
+                player->token_positions[j] = -1;
+                if(j < n) fresh->position_hash ^= zobrist_token[i][j][0];
+            }
+        }
+    }
 }
 
+static uint8_t pack_flags(Player* player) {
+    return (player->is_active ? PACK_ACTIVE : 0) |
+           (player->hit_record > 0 ? PACK_KILLED : 0) |
+           (player->consecutive_sixes << 2) |
+           (player->rank << 4);
+}
 
-
-void check_hits(Player* player, int new_row, int new_col) {
-    pthread_mutex_lock(&board_mutex);
+// Snapshot the rule-relevant part of a game; returns its Zobrist hash.
+// Hit counts collapse to the killed flag and the stuck counter is not kept.
+uint64_t pack_game(Game* game, int to_move, PackedState* out) {
+    uint64_t hash = game->position_hash ^ zobrist_turn[to_move];
     
-    // First check if there's a team block
-    if(team_mode) {
-        int block_count = 0;
-        int block_team = -1;
-        
-        for(int p = 0; p < NUM_PLAYERS; p++) {
-            if(p == player->id) continue;
-            
-            for(int t = 0; t < players[p].num_tokens; t++) {
-                if(players[p].tokens[t][0] == new_row && 
-                   players[p].tokens[t][1] == new_col) {
-                    if(block_count == 0) {
-                        for(int i = 0; i < 2; i++) {
-                            if(teams[i].player1_id == p || teams[i].player2_id == p) {
-                                block_team = i;
-                                break;
-                            }
-                        }
-                        block_count++;
-                    } else if(block_team != -1) {
-                        // Check if second piece belongs to same team
-                        if((teams[block_team].player1_id == p || teams[block_team].player2_id == p) &&
-                           !are_teammates(player->id, p)) {
-                            // This is a team block, cannot move here
-                            pthread_mutex_unlock(&board_mutex);
-                            return;
-                        }
-                    }
-                }
-            }
+    memset(out, 0, sizeof(*out));
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        Player* player = &game->players[p];
+        for(int t = 0; t < player->num_tokens; t++) {
+            out->pos[p][t] = (uint8_t)(player->token_positions[t] + 1);
         }
+        out->flags[p] = pack_flags(player);
+        hash ^= zobrist_flags[p][out->flags[p]];
     }
+    out->to_move = (uint8_t)to_move;
+    out->config = (uint8_t)game->num_tokens_per_player | (uint8_t)(game->rules << 3) |
+                  (game->team_mode ? PACK_TEAM_MODE : 0);
+    return hash;
+}
+
+// Full hash of a packed position, for checking the incremental one
+uint64_t zobrist_hash(const PackedState* state) {
+    int num_tokens = state->config & 0x07;
+    uint64_t hash = zobrist_turn[state->to_move];
     
-    // Regular hit check
     for(int p = 0; p < NUM_PLAYERS; p++) {
-        if(p == player->id || (team_mode && are_teammates(player->id, p))) continue;
-        
-        for(int t = 0; t < players[p].num_tokens; t++) {
-            if(players[p].tokens[t][0] == new_row && 
-               players[p].tokens[t][1] == new_col && 
-               players[p].token_positions[t] >= 0 &&
-               !is_safe_square(new_row, new_col)) {
-                
-                players[p].tokens[t][0] = players[p].tokens[t][0];
-                players[p].tokens[t][1] = players[p].tokens[t][1];
-                players[p].token_positions[t] = -1;
-                
-                player->hit_record++;
-                printf("\n\033[1;37m[HIT]\033[0m Player %s hit Player %s's token %d!\n", 
-                       player->color, players[p].color, t + 1);
-                pthread_mutex_unlock(&board_mutex);
-                return;
-            }
+        for(int t = 0; t < num_tokens; t++) {
+            hash ^= zobrist_token[p][t][state->pos[p][t]];
         }
+        hash ^= zobrist_flags[p][state->flags[p]];
     }
-    pthread_mutex_unlock(&board_mutex);
+    return hash;
 }
 
+// Move a token inside a packed position, updating its hash in place
+void packed_set_token(PackedState* state, uint64_t* hash, int player_id, int token_idx, int new_pos) {
+    *hash ^= zobrist_token[player_id][token_idx][state->pos[player_id][token_idx]] ^
+             zobrist_token[player_id][token_idx][new_pos + 1];
+    state->pos[player_id][token_idx] = (uint8_t)(new_pos + 1);
+}
 
-void move_token(Player* player, int token_idx, int steps) {
-    int curr_pos = player->token_positions[token_idx];
-    int new_pos = curr_pos + steps;
+void packed_set_flags(PackedState* state, uint64_t* hash, int player_id, uint8_t flags) {
+    *hash ^= zobrist_flags[player_id][state->flags[player_id]] ^ zobrist_flags[player_id][flags];
+    state->flags[player_id] = flags;
+}
+
+void packed_set_turn(PackedState* state, uint64_t* hash, int to_move) {
+    *hash ^= zobrist_turn[state->to_move] ^ zobrist_turn[to_move];
+    state->to_move = (uint8_t)to_move;
+}
+
+// Rebuild a playable game from a packed position; returns the player to move
+int unpack_game(const PackedState* state, Game* game) {
+    game->num_tokens_per_player = state->config & 0x07;
+    game->team_mode = false;
+    if(state->config & PACK_TEAM_MODE) setup_teams(game);
     
-    // Handle movement beyond PATH_LENGTH
-    if(new_pos >= PATH_LENGTH) {
-        if(team_mode || has_killed_token(player)) {
-            // Original behavior for team mode or after getting a kill
-            if(team_mode || can_enter_home(player)) {
-                player->home_tokens++;
-                player->token_positions[token_idx] = PATH_LENGTH;
-                player->tokens[token_idx][0] = -1;  // Remove token from board
-                player->tokens[token_idx][1] = -1;
-                printf("\n\033[1;32m[HOME]\033[0m Player %s's token %d reached home!\n", 
-                       player->color, token_idx + 1);
-                return;
-            }
-            return;
-        } else {
-            // Loop back to start if no kill yet
-            new_pos = new_pos % PATH_LENGTH;
-            printf("\n\033[1;33m[LOOP]\033[0m Player %s's token %d loops back to continue hunting!\n", 
-                   player->color, token_idx + 1);
+    reset_players(game);
+    game->rules = PACK_RULES(state->config);
+    game->active_players = 0;
+    game->current_rank = 1;
+    
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        Player* player = &game->players[p];
+        uint8_t flags = state->flags[p];
+        
+        for(int t = 0; t < player->num_tokens; t++) {
+            place_token(game, player, t, state->pos[p][t] - 1);
+            if(player->token_positions[t] >= PATH_LENGTH) player->home_tokens++;
         }
+        player->is_active = flags & PACK_ACTIVE;
+        player->hit_record = (flags & PACK_KILLED) ? 1 : 0;
+        player->consecutive_sixes = PACK_SIXES(flags);
+        player->rank = PACK_RANK(flags);
+        
+        if(player->is_active) game->active_players++;
+        if(player->rank > 0) game->current_rank++;
     }
+    return state->to_move;
+}
+
+// Glyph code of a board cell: '0' + arm for a token of the seat on that arm, otherwise the board marker
+static void cell_style(char code, int* color, const char** text) {
+    static const char* symbols[NUM_ARMS] = {"R", "Y", "G", "B"};
     
-    int new_row = path_coords[player->id][new_pos][0];
-    int new_col = path_coords[player->id][new_pos][1];
-    
-    check_hits(player, new_row, new_col);
+    switch(code) {
+        case 'R': case 'r': case '0': *color = 31; break;  // Red
+        case 'Y': case 'y': case '1': *color = 33; break;  // Yellow
+        case 'G': case 'g': case '2': *color = 32; break;  // Green
+        case 'B': case 'b': case '3': *color = 34; break;  // Blue
+        case 'S': *color = 37; break;
+        default: *color = 0;
+    }
     
-    player->tokens[token_idx][0] = new_row;
-    player->tokens[token_idx][1] = new_col;
-    player->token_positions[token_idx] = new_pos;
+    if(code >= '0' && code < '0' + NUM_ARMS) *text = symbols[code - '0'];
+    else if(code == 'S') *text = "*";
+    else if(code >= 'A' && code <= 'Z') *text = "█";   // Home
+    else if(code >= 'a' && code <= 'z') *text = "•";   // Dot
+    else *text = "□";
 }
 
-bool check_win(Player* player) {
-    if(!team_mode) {
-        return player->home_tokens == player->num_tokens;
+static void frame_append(Renderer* r, const char* bytes, int len) {
+    if(r->len + len <= FRAME_BUFFER_SIZE) {
+        memcpy(r->buf + r->len, bytes, len);
+        r->len += len;
+    }
+}
+
+// Copy the token positions a frame needs
+void snapshot_board(Game* game, BoardSnapshot* snap) {
+    lock_board(game);
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        snap->num_tokens[p] = (int8_t)game->players[p].num_tokens;
+        for(int t = 0; t < game->players[p].num_tokens; t++) {
+            snap->pos[p][t] = (int8_t)game->players[p].token_positions[t];
+        }
     }
+    unlock_board(game);
+}
+
+// Build the bytes that bring the screen up to date with a snapshot into r->buf.
+// Only cells that differ from the last frame are sent, each behind a cursor move;
+// the first frame clears the screen and pins the board above a scrolling text area.
+void render_snapshot(Renderer* r, const BoardSnapshot* snap) {
+    char frame[BOARD_SIZE][BOARD_SIZE];
+    char seq[32];
+    int n;
     
-    // In team mode, check if both players in the team have finished
-    if(player->home_tokens == player->num_tokens) {
-        for(int i = 0; i < 2; i++) {
-            if(teams[i].player1_id == player->id || teams[i].player2_id == player->id) {
-                int teammate_id = (teams[i].player1_id == player->id) ? 
-                                 teams[i].player2_id : teams[i].player1_id;
-                
-                // Only count as a win if both players have finished
-                if(players[teammate_id].home_tokens == players[teammate_id].num_tokens && 
-                   player->home_tokens == player->num_tokens) {
-                    // Set both players as inactive
+    memcpy(frame, board, sizeof(frame));
+    for(int p = NUM_PLAYERS - 1; p >= 0; p--) {
+        for(int t = 0; t < snap->num_tokens[p]; t++) {
+            int row, col;
+            position_cell(p, t, snap->pos[p][t], &row, &col);
+            frame[row][col] = '0' + SEAT_ARM(p);  // The lowest-numbered player wins a shared cell
+        }
+    }
+    
+    r->len = 0;
+    if(!r->on_screen) {
+        n = snprintf(seq, sizeof(seq), "\033[H\033[2J\033[%dr", BOARD_TOP_ROW + BOARD_SIZE + 1);
+        frame_append(r, seq, n);
+        memset(r->shown, 0, sizeof(r->shown));
+    } else {
+        frame_append(r, "\0337", 2);  // Save the text area cursor
+    }
+    
+    int changed = 0;
+    int last_row = -1, last_col = -1, current_color = -1;
+    for(int i = 0; i < BOARD_SIZE; i++) {
+        for(int j = 0; j < BOARD_SIZE; j++) {
+            if(frame[i][j] == r->shown[i][j]) continue;
+            
+            int color;
+            const char* text;
+            cell_style(frame[i][j], &color, &text);
+            
+            if(i != last_row || j != last_col + 1) {
+                n = snprintf(seq, sizeof(seq), "\033[%d;%dH", BOARD_TOP_ROW + i, 1 + 2 * j);
+                frame_append(r, seq, n);
+            }
+            if(color != current_color) {
+                n = color ? snprintf(seq, sizeof(seq), "\033[1;%dm", color) : snprintf(seq, sizeof(seq), "\033[0m");
+                frame_append(r, seq, n);
+                current_color = color;
+            }
+            frame_append(r, text, strlen(text));
+            frame_append(r, " ", 1);
+            
+            r->shown[i][j] = frame[i][j];
+            last_row = i;
+            last_col = j;
+            changed++;
+        }
+    }
+    
+    if(current_color > 0) frame_append(r, "\033[0m", 4);
+    
+    if(!r->on_screen) {
+        n = snprintf(seq, sizeof(seq), "\033[%d;1H", BOARD_TOP_ROW + BOARD_SIZE + 1);
+        frame_append(r, seq, n);
+        r->on_screen = true;
+    } else if(changed == 0) {
+        r->len = 0;
+    } else {
+        frame_append(r, "\0338", 2);  // Back to the text area
+    }
+}
+
+void render_frame(Renderer* r, Game* game) {
+    BoardSnapshot snap;
+    snapshot_board(game, &snap);
+    render_snapshot(r, &snap);
+}
+
+static void write_all(int fd, const char* buf, int len) {
+    while(len > 0) {
+        ssize_t written = write(fd, buf, len);
+        if(written <= 0) return;
+        buf += written;
+        len -= written;
+    }
+}
+
+static void draw_snapshot(const BoardSnapshot* snap) {
+    pthread_mutex_lock(&renderer.lock);
+    render_snapshot(&renderer, snap);
+    fflush(stdout);  // Narrative printed so far goes out before the frame
+    write_all(STDOUT_FILENO, renderer.buf, renderer.len);
+    pthread_mutex_unlock(&renderer.lock);
+}
+
+// Claim the next free ring slot, or NULL when the ring is full
+static ConsoleSlot* console_claim(size_t* ticket) {
+    size_t pos = atomic_load_explicit(&console.head, memory_order_relaxed);
+    while(true) {
+        ConsoleSlot* slot = &console.slots[pos & (CONSOLE_SLOTS - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t lag = (intptr_t)seq - (intptr_t)pos;
+        if(lag == 0) {
+            if(atomic_compare_exchange_weak_explicit(&console.head, &pos, pos + 1,
+                                                     memory_order_relaxed, memory_order_relaxed)) {
+                *ticket = pos;
+                return slot;
+            }
+        } else if(lag < 0) {
+            return NULL;  // The renderer has not read this slot's last message yet
+        } else {
+            pos = atomic_load_explicit(&console.head, memory_order_relaxed);
+        }
+    }
+}
+
+static void console_publish(ConsoleSlot* slot, size_t ticket) {
+    atomic_store_explicit(&slot->seq, ticket + 1, memory_order_release);
+    sem_post(&console.ready);
+}
+
+// Queue narrative text for the renderer; printed directly when no renderer runs
+void console_printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    if(!atomic_load_explicit(&console.running, memory_order_acquire)) {
+        vprintf(format, args);
+    } else {
+        size_t ticket;
+        ConsoleSlot* slot = console_claim(&ticket);
+        if(slot) {
+            slot->kind = CONSOLE_TEXT;
+            vsnprintf(slot->text, sizeof(slot->text), format, args);
+            console_publish(slot, ticket);
+        } else {
+            atomic_fetch_add_explicit(&console.lines_dropped, 1, memory_order_relaxed);
+        }
+    }
+    va_end(args);
+}
+
+// Show the board: queued for the renderer thread while it runs, drawn in place otherwise
+void display_board(Game* game) {
+    if(!atomic_load_explicit(&console.running, memory_order_acquire)) {
+        BoardSnapshot snap;
+        snapshot_board(game, &snap);
+        draw_snapshot(&snap);
+        return;
+    }
+    
+    size_t ticket;
+    ConsoleSlot* slot = console_claim(&ticket);
+    if(slot) {
+        slot->kind = CONSOLE_FRAME;
+        snapshot_board(game, &slot->board);
+        console_publish(slot, ticket);
+    } else {
+        atomic_fetch_add_explicit(&console.frames_dropped, 1, memory_order_relaxed);
+    }
+}
+
+// Print every queued line in order, but draw only the newest frame of the batch,
+// so a slow terminal costs frames rather than game time
+static void console_drain(void) {
+    BoardSnapshot frame;
+    bool pending = false;
+    
+    while(true) {
+        ConsoleSlot* slot = &console.slots[console.tail & (CONSOLE_SLOTS - 1)];
+        if(atomic_load_explicit(&slot->seq, memory_order_acquire) != console.tail + 1) break;
+        
+        if(slot->kind == CONSOLE_TEXT) {
+            fputs(slot->text, stdout);
+        } else {
+            if(pending) atomic_fetch_add_explicit(&console.frames_dropped, 1, memory_order_relaxed);
+            frame = slot->board;
+            pending = true;
+        }
+        atomic_store_explicit(&slot->seq, console.tail + CONSOLE_SLOTS, memory_order_release);
+        console.tail++;
+    }
+    
+    if(pending) {
+        draw_snapshot(&frame);
+        console.frames_drawn++;
+    } else {
+        fflush(stdout);
+    }
+}
+
+static void* console_renderer(void* arg) {
+    (void)arg;
+    while(true) {
+        sem_wait(&console.ready);
+        bool stopping = !atomic_load_explicit(&console.running, memory_order_acquire);
+        console_drain();
+        if(stopping) return NULL;
+    }
+}
+
+// Hand all game output to a renderer thread until console_stop
+void console_start(void) {
+    for(size_t i = 0; i < CONSOLE_SLOTS; i++) {
+        atomic_init(&console.slots[i].seq, i);
+    }
+    atomic_init(&console.head, 0);
+    console.tail = 0;
+    sem_init(&console.ready, 0, 0);
+    fflush(stdout);
+    atomic_store_explicit(&console.running, true, memory_order_release);
+    pthread_create(&console.thread_id, NULL, console_renderer, NULL);
+}
+
+// Drain what is queued, stop the renderer and print directly again
+void console_stop(void) {
+    atomic_store_explicit(&console.running, false, memory_order_release);
+    sem_post(&console.ready);
+    pthread_join(console.thread_id, NULL);
+    console_drain();  // Anything a player thread queued while the renderer was stopping
+    sem_destroy(&console.ready);
+}
+
+// Give the whole terminal back to normal scrolling output
+void close_display(void) {
+    pthread_mutex_lock(&renderer.lock);
+    if(renderer.on_screen) {
+        fflush(stdout);
+        write_all(STDOUT_FILENO, "\0337\033[r\0338", 7);
+        renderer.on_screen = false;
+    }
+    pthread_mutex_unlock(&renderer.lock);
+}
+
+uint64_t splitmix64(uint64_t* x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(Rng* rng, uint64_t seed) {
+    for(int i = 0; i < 4; i++) {
+        rng->s[i] = splitmix64(&seed);
+    }
+}
+
+static inline uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(Rng* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return result;
+}
+
+// Uniform value in [0, n) from the top 32 bits, without a division
+static inline int rng_below(Rng* rng, int n) {
+    return (int)(((rng_next(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+int roll_dice(Game* game) {
+    lock_dice(game);
+    int result = game->next_roll ? game->next_roll(game) : rng_below(&game->rng, 6) + 1;
+    if(game->replay && game->replay->out) replay_event(game->replay, REPLAY_ROLL | result, -1);
+    GAME_EVENT(game, EV_ROLL | result);
+    unlock_dice(game);
+    return result;
+}
+
+
+static const char replay_magic[4] = {'L', 'U', 'D', 'R'};
+
+void replay_event(Replay* r, int tag, int arg) {
+    putc(tag, r->out);
+    if(arg >= 0) putc(arg, r->out);
+    r->events++;
+}
+
+// Header: magic, format version, tokens per player, team mode | empty arms << 1, rules, then the seed
+// (little endian); four-seat logs keep the empty-arm bits clear
+void replay_begin_game(Replay* r, Game* game, uint64_t seed) {
+    uint8_t header[REPLAY_HEADER_SIZE] = {0};
+    memcpy(header, replay_magic, 4);
+    header[4] = 1;
+    header[5] = (uint8_t)game->num_tokens_per_player;
+    header[6] = (uint8_t)((game->team_mode ? 1 : 0) | (NUM_ARMS - NUM_PLAYERS) << 1);
+    header[7] = game->rules;
+    for(int i = 0; i < 8; i++) {
+        header[8 + i] = (uint8_t)(seed >> (8 * i));
+    }
+    fwrite(header, 1, sizeof(header), r->out);
+}
+
+void record_turn(Game* game, int player_id) {
+    if(game->replay && game->replay->out) replay_event(game->replay, REPLAY_TURN | player_id, -1);
+    GAME_EVENT(game, EV_TURN | player_id);
+}
+
+void record_game_end(Game* game) {
+    if(game->replay && game->replay->out) replay_event(game->replay, REPLAY_END, -1);
+    event_end_game(game);
+}
+
+// Playback: mark the log as diverged at the current event
+static void replay_diverge(Replay* r) {
+    if(!r->diverged) {
+        r->diverged = true;
+        r->diverged_at = r->pos;
+    }
+}
+
+// Dice stream that hands out the rolls stored in the log
+int replay_roll(Game* game) {
+    Replay* r = game->replay;
+    if(r->diverged || r->pos >= r->len || (r->data[r->pos] & 0xC0) != REPLAY_ROLL) {
+        replay_diverge(r);
+        return 1;
+    }
+    r->events++;
+    return r->data[r->pos++] & 0x07;
+}
+
+// Recording appends the move; playback checks it is the one in the log
+void replay_move(Game* game, int player_id, int token_idx, int new_pos) {
+    Replay* r = game->replay;
+    int tag = REPLAY_MOVE | (player_id << 2) | token_idx;
+    int arg = new_pos < 0 ? 0xFF : new_pos;
+    
+    if(r->out) {
+        replay_event(r, tag, arg);
+        return;
+    }
+    if(r->diverged) return;
+    if(r->pos + 1 >= r->len || r->data[r->pos] != tag || r->data[r->pos + 1] != arg) {
+        replay_diverge(r);
+        return;
+    }
+    r->pos += 2;
+    r->events++;
+}
+
+// Playback chooser: the token the log shows this player moving next, so games
+// played by AI seats check as well; a capture's move to the yard may come first
+int replay_choose(Game* game, Player* player, int dice_value) {
+    Replay* r = game->replay;
+    int tokens[MAX_TOKENS];
+    int count = movable_tokens(game, player, dice_value, tokens);
+    
+    for(size_t at = r->pos; at + 1 < r->len && (r->data[at] & 0xC0) == REPLAY_MOVE; at += 2) {
+        if(((r->data[at] >> 2) & 0x03) != player->id) continue;
+        for(int i = 0; i < count; i++) {
+            if(tokens[i] == (r->data[at] & 0x03)) return tokens[i];
+        }
+        break;
+    }
+    return count ? tokens[0] : -1;
+}
+
+// Event log writer. Each stream fills its active buffer without locking; a full
+// buffer is queued for the flusher thread, which compresses and appends it while
+// the stream carries on in its other buffer. A game thread only waits when the
+// flusher is a whole block behind it.
+
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+
+static const char event_magic[4] = {'L', 'U', 'D', 'B'};
+
+// Block header, followed by packed_len bytes; packed_len == raw_len means stored as is
+typedef struct {
+    char magic[4];
+    uint32_t stream;
+    uint32_t raw_len;
+    uint32_t packed_len;
+} EventBlockHeader;
+
+typedef struct {
+    EventStream* stream;
+    int buffer;
+    int len;
+} EventBlock;
+
+struct EventLog {
+    int fd;
+    int num_streams;
+    EventStream* streams;
+    EventBlock* queue;         // Ring of blocks waiting for the flusher, two per stream at most
+    int queue_head;
+    int queue_count;
+    bool closing;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;       // Flusher: a block was queued or the log is closing
+    pthread_cond_t written;    // Streams: a queued buffer is free again
+    pthread_t flusher;
+    uint8_t* packed;           // Flusher's output buffer, header included
+    long raw_bytes;
+    long file_bytes;
+    long blocks;
+};
+
+static inline uint32_t lz_hash(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static uint8_t* lz_length(uint8_t* out, int n) {
+    for(; n >= 255; n -= 255) *out++ = 255;
+    *out++ = (uint8_t)n;
+    return out;
+}
+
+// LZ77 in the LZ4 block layout: a token with the literal and match lengths (4 bits
+// each, 15 meaning more bytes follow), the literals, then a 16-bit match offset.
+// The last sequence has literals only. Returns the packed size, or 0 when packing
+// would not make the block smaller.
+int lz_pack(const uint8_t* src, int len, uint8_t* dst) {
+    int32_t table[1 << LZ_HASH_BITS];
+    uint8_t* out = dst;
+    uint8_t* limit = dst + len;
+    int anchor = 0;
+    int i = 0;
+    
+    memset(table, 0xFF, sizeof(table));
+    while(i + LZ_MIN_MATCH <= len) {
+        uint32_t h = lz_hash(src + i);
+        int candidate = table[h];
+        table[h] = i;
+        if(candidate < 0 || i - candidate > 0xFFFF || memcmp(src + candidate, src + i, LZ_MIN_MATCH) != 0) {
+            i++;
+            continue;
+        }
+        
+        int match = LZ_MIN_MATCH;
+        while(i + match < len && src[candidate + match] == src[i + match]) match++;
+        int literals = i - anchor;
+        if(out + literals + literals / 255 + match / 255 + 5 > limit) return 0;
+        
+        uint8_t* token = out++;
+        *token = (uint8_t)((literals < 15 ? literals : 15) << 4 |
+                           (match - LZ_MIN_MATCH < 15 ? match - LZ_MIN_MATCH : 15));
+        if(literals >= 15) out = lz_length(out, literals - 15);
+        memcpy(out, src + anchor, literals);
+        out += literals;
+        *out++ = (uint8_t)(i - candidate);
+        *out++ = (uint8_t)((i - candidate) >> 8);
+        if(match - LZ_MIN_MATCH >= 15) out = lz_length(out, match - LZ_MIN_MATCH - 15);
+        i += match;
+        anchor = i;
+    }
+    
+    int literals = len - anchor;
+    if(out + literals + literals / 255 + 2 >= limit) return 0;
+    *out++ = (uint8_t)((literals < 15 ? literals : 15) << 4);
+    if(literals >= 15) out = lz_length(out, literals - 15);
+    memcpy(out, src + anchor, literals);
+    out += literals;
+    return (int)(out - dst);
+}
+
+static bool lz_read_length(const uint8_t** in, const uint8_t* end, int* n) {
+    int byte;
+    do {
+        if(*in >= end) return false;
+        byte = *(*in)++;
+        *n += byte;
+    } while(byte == 255);
+    return true;
+}
+
+// Returns the unpacked size, or -1 if the block is corrupt or does not fit in cap
+int lz_unpack(const uint8_t* src, int len, uint8_t* dst, int cap) {
+    const uint8_t* in = src;
+    const uint8_t* end = src + len;
+    uint8_t* out = dst;
+    
+    while(in < end) {
+        int token = *in++;
+        int literals = token >> 4;
+        if(literals == 15 && !lz_read_length(&in, end, &literals)) return -1;
+        if(literals > end - in || literals > cap - (out - dst)) return -1;
+        memcpy(out, in, literals);
+        in += literals;
+        out += literals;
+        if(in == end) break;
+        
+        if(end - in < 2) return -1;
+        int offset = in[0] | in[1] << 8;
+        in += 2;
+        int match = token & 15;
+        if(match == 15 && !lz_read_length(&in, end, &match)) return -1;
+        match += LZ_MIN_MATCH;
+        if(offset == 0 || offset > out - dst || match > cap - (out - dst)) return -1;
+        if(offset >= match) {
+            memcpy(out, out - offset, match);
+        } else {
+            for(int k = 0; k < match; k++) out[k] = out[k - offset];
+        }
+        out += match;
+    }
+    return (int)(out - dst);
+}
+
+static void event_write_block(EventLog* log, const EventBlock* block) {
+    EventBlockHeader header;
+    const uint8_t* raw = block->stream->buf[block->buffer];
+    uint8_t* payload = log->packed + sizeof(header);
+    int packed_len = lz_pack(raw, block->len, payload);
+    if(!packed_len) {
+        memcpy(payload, raw, block->len);
+        packed_len = block->len;
+    }
+    
+    memcpy(header.magic, event_magic, 4);
+    header.stream = block->stream->id;
+    header.raw_len = (uint32_t)block->len;
+    header.packed_len = (uint32_t)packed_len;
+    memcpy(log->packed, &header, sizeof(header));
+    write_all(log->fd, (const char*)log->packed, (int)sizeof(header) + packed_len);
+    
+    log->raw_bytes += block->len;
+    log->file_bytes += (long)sizeof(header) + packed_len;
+    log->blocks++;
+}
+
+static void* event_flusher(void* arg) {
+    EventLog* log = (EventLog*)arg;
+    
+    pthread_mutex_lock(&log->lock);
+    for(;;) {
+        while(!log->queue_count && !log->closing) pthread_cond_wait(&log->wake, &log->lock);
+        if(!log->queue_count) break;
+        EventBlock block = log->queue[log->queue_head];
+        log->queue_head = (log->queue_head + 1) % (2 * log->num_streams);
+        log->queue_count--;
+        pthread_mutex_unlock(&log->lock);
+        
+        event_write_block(log, &block);
+        
+        pthread_mutex_lock(&log->lock);
+        block.stream->queued[block.buffer] = false;
+        pthread_cond_broadcast(&log->written);
+    }
+    pthread_mutex_unlock(&log->lock);
+    return NULL;
+}
+
+// Queue the stream's active buffer and, unless closing, switch to the other one
+static void event_queue(EventStream* s, bool closing) {
+    EventLog* log = s->log;
+    
+    pthread_mutex_lock(&log->lock);
+    if(s->len) {
+        int tail = (log->queue_head + log->queue_count) % (2 * log->num_streams);
+        log->queue[tail] = (EventBlock){ s, s->active, s->len };
+        log->queue_count++;
+        s->queued[s->active] = true;
+        pthread_cond_signal(&log->wake);
+    }
+    if(!closing) {
+        s->active ^= 1;
+        s->len = 0;
+        while(s->queued[s->active]) pthread_cond_wait(&log->written, &log->lock);
+    }
+    pthread_mutex_unlock(&log->lock);
+}
+
+void event_put(EventStream* s, const uint8_t* bytes, int len) {
+    if(s->len + len > EVENT_BLOCK_SIZE) event_queue(s, false);
+    memcpy(s->buf[s->active] + s->len, bytes, len);
+    s->len += len;
+}
+
+static void event_put_u32(uint8_t* out, uint32_t v) {
+    for(int i = 0; i < 4; i++) out[i] = (uint8_t)(v >> (8 * i));
+}
+
+void event_begin_game(Game* game, int game_index, uint64_t seed) {
+    if(!game->events) return;
+    uint8_t bytes[13];
+    bytes[0] = (uint8_t)(EV_GAME | game->num_tokens_per_player | (game->team_mode ? 0x08 : 0));
+    event_put_u32(bytes + 1, (uint32_t)game_index);
+    event_put_u32(bytes + 5, (uint32_t)seed);
+    event_put_u32(bytes + 9, (uint32_t)(seed >> 32));
+    event_put(game->events, bytes, sizeof(bytes));
+}
+
+void event_end_game(Game* game) {
+    if(!game->events) return;
+    uint8_t bytes[5 + 2 * NUM_PLAYERS];
+    bytes[0] = EV_END;
+    event_put_u32(bytes + 1, (uint32_t)game->turn_count);
+    for(int i = 0; i < NUM_PLAYERS; i++) {
+        bytes[5 + i] = (uint8_t)game->players[i].rank;
+        bytes[5 + NUM_PLAYERS + i] = (uint8_t)(game->players[i].hit_record < 255 ? game->players[i].hit_record : 255);
+    }
+    event_put(game->events, bytes, sizeof(bytes));
+}
+
+// Open path for appending, with one stream per game thread
+int event_log_open(EventLog* log, const char* path, int num_streams) {
+    memset(log, 0, sizeof(*log));
+    log->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(log->fd < 0) {
+        perror(path);
+        return 1;
+    }
+    log->num_streams = num_streams;
+    log->streams = calloc(num_streams, sizeof(EventStream));
+    log->queue = calloc(2 * num_streams, sizeof(EventBlock));
+    log->packed = malloc(sizeof(EventBlockHeader) + EVENT_BLOCK_SIZE);
+    if(!log->streams || !log->queue || !log->packed) {
+        fprintf(stderr, "Out of memory for %d event streams\n", num_streams);
+        close(log->fd);
+        free(log->streams);
+        free(log->queue);
+        free(log->packed);
+        return 1;
+    }
+    for(int i = 0; i < num_streams; i++) {
+        log->streams[i].log = log;
+        log->streams[i].id = (uint32_t)i;
+    }
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->wake, NULL);
+    pthread_cond_init(&log->written, NULL);
+    pthread_create(&log->flusher, NULL, event_flusher, log);
+    return 0;
+}
+
+// Flush every stream, wait for the flusher to finish and print what was written
+void event_log_close(EventLog* log) {
+    for(int i = 0; i < log->num_streams; i++) {
+        event_queue(&log->streams[i], true);
+    }
+    pthread_mutex_lock(&log->lock);
+    log->closing = true;
+    pthread_cond_signal(&log->wake);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->flusher, NULL);
+    
+    printf("Event log: %.1f MB of events in %ld blocks, %.1f MB on disk (%.2fx)\n",
+           log->raw_bytes / 1e6, log->blocks, log->file_bytes / 1e6,
+           log->file_bytes ? (double)log->raw_bytes / log->file_bytes : 0.0);
+    
+    close(log->fd);
+    pthread_mutex_destroy(&log->lock);
+    pthread_cond_destroy(&log->wake);
+    pthread_cond_destroy(&log->written);
+    free(log->streams);
+    free(log->queue);
+    free(log->packed);
+}
+
+bool is_safe_square(const Game* game, int cell) {
+    if((ring_safe_mask >> cell) & 1) return true;
+    
+    return game->ring_occupancy[cell] == 0;
+}
+
+bool can_enter_home(const Player* player) {
+    return player->hit_record > 0;
+}
+
+bool is_token_home(const Player* player, int token_idx) {
+    int pos = player->token_positions[token_idx];
+    return pos >= PATH_LENGTH;
+}
+
+bool can_move_token(const Game* game, const Player* player, int token_idx, int steps) {
+    if(is_token_home(player, token_idx)) return false;
+    
+    int curr_pos = player->token_positions[token_idx];
+    int new_pos = curr_pos + steps;
+    
+    // If token would move beyond PATH_LENGTH
+    if(new_pos >= PATH_LENGTH) {
+        // The gate opens after a kill (the team's, in team mode) or under the no-kill-gate rule
+        if(!can_pass_gate(game, player)) {
+            new_pos = new_pos % PATH_LENGTH;  // Loop back until then
+        } else {
+            return new_pos == PATH_LENGTH;  // Home needs an exact roll
+        }
+    }
+    
+    int cell = ring_cell(player->id, new_pos);
+    
+    // Check for central path access; gate cells are 13 apart, so a move never starts on one
+    bool entering_central_path = (ring_gate_mask >> cell) & 1;
+    
+    if(entering_central_path && !can_pass_gate(game, player)) {
+        return false;  // The central path needs a kill, like the gate
+    }
+    
+    // An occupied safe square is blocked
+    if(((ring_safe_mask >> cell) & 1) && game->ring_occupancy[cell] != 0) {
+        return false;
+    }
+    
+    return true;
+}
+
+
+
+// Player mask of the occupancy bits owned by player_id's tokens
+static inline uint16_t player_bits(int player_id) {
+    return (uint16_t)(((1u << MAX_TOKENS) - 1) << (player_id * MAX_TOKENS));
+}
+
+void check_hits(Game* game, Player* player, int cell) {
+    lock_board(game);
+    
+    uint16_t friendly = player_bits(player->id);
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        if(p != player->id && game->team_mode && are_teammates(game, player->id, p)) {
+            friendly |= player_bits(p);
+        }
+    }
+    uint16_t opponents = game->ring_occupancy[cell] & ~friendly;
+    
+    // Two or more tokens of the opposing team form a block that cannot be hit
+    if(game->team_mode && __builtin_popcount(opponents) >= 2) {
+        unlock_board(game);
+        return;
+    }
+    
+    // Regular hit check
+    if(opponents && !is_safe_square(game, cell)) {
+        int bit = __builtin_ctz(opponents);
+        int p = bit / MAX_TOKENS;
+        int t = bit % MAX_TOKENS;
+        
+        GAME_EVENT(game, EV_HIT | bit);
+        place_token(game, &game->players[p], t, -1);
+        
+        player->hit_record++;
+        GAME_LOG(game, "\n\033[1;37m[HIT]\033[0m Player %s hit Player %s's token %d!\n", 
+               player->color, game->players[p].color, t + 1);
+    }
+    unlock_board(game);
+}
+
+
+void move_token(Game* game, Player* player, int token_idx, int steps) {
+    int curr_pos = player->token_positions[token_idx];
+    int new_pos = curr_pos + steps;
+    
+    // Handle movement beyond PATH_LENGTH
+    if(new_pos >= PATH_LENGTH) {
+        if(game->team_mode || can_pass_gate(game, player)) {
+            // Team mode, or the player may pass its gate (a kill, or the no-kill-gate rule)
+            player->home_tokens++;
+            GAME_EVENT(game, EV_HOME | (player->id << 2) | token_idx);
+            place_token(game, player, token_idx, PATH_LENGTH);
+            GAME_LOG(game, "\n\033[1;32m[HOME]\033[0m Player %s's token %d reached home!\n", 
+                   player->color, token_idx + 1);
+            return;
+        } else {
+            // Loop back to start until the player may pass its gate
+            new_pos = new_pos % PATH_LENGTH;
+            GAME_EVENT(game, EV_LOOP | (player->id << 2) | token_idx);
+            GAME_LOG(game, "\n\033[1;33m[LOOP]\033[0m Player %s's token %d loops back to continue hunting!\n", 
+                   player->color, token_idx + 1);
+        }
+    }
+    
+    INSTR_TIMER(hits_start, game);
+    check_hits(game, player, ring_cell(player->id, new_pos));
+    INSTR_RECORD(hits_start, LAT_HITS);
+    
+    place_token(game, player, token_idx, new_pos);
+}
+
+// Describe moving one token the way play_token/move_token would carry it out
+static void describe_move(const Game* game, const Player* player, int token_idx, int steps,
+                          bool entering, Move* move) {
+    int from = player->token_positions[token_idx];
+    int to = from + steps;
+    
+    move->player_id = (uint8_t)player->id;
+    move->token_idx = (uint8_t)token_idx;
+    move->from = (int8_t)from;
+    move->flags = 0;
+    move->captured = 0;
+    
+    if(entering) {
+        move->to = 0;
+        move->flags = MOVE_ENTER;  // Entering never hits
+        return;
+    }
+    if(to >= PATH_LENGTH) {
+        if(game->team_mode || can_pass_gate(game, player)) {
+            move->to = PATH_LENGTH;
+            move->flags = MOVE_HOME;
+            return;
+        }
+        to %= PATH_LENGTH;
+        move->flags = MOVE_LOOP;
+    }
+    move->to = (int8_t)to;
+    
+    // Same test as check_hits
+    int cell = ring_cell(player->id, to);
+    uint16_t friendly = player_bits(player->id);
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        if(p != player->id && game->team_mode && are_teammates(game, player->id, p)) {
+            friendly |= player_bits(p);
+        }
+    }
+    uint16_t opponents = game->ring_occupancy[cell] & ~friendly;
+    
+    if(game->team_mode && __builtin_popcount(opponents) >= 2) {
+        move->flags |= MOVE_TEAM_BLOCK;
+    } else if(opponents && !is_safe_square(game, cell)) {
+        move->flags |= MOVE_CAPTURE;
+        move->captured = (uint8_t)__builtin_ctz(opponents);
+    }
+}
+
+// Every legal move for player_id with dice_value, in the order the built-in bot
+// tries them; returns how many. Reads the game only: no allocation, no output.
+// A finished team player gets its teammate's moves (the engine rolls for those
+// separately after the player's 6), flagged MOVE_TEAMMATE.
+int generate_moves(const Game* game, int player_id, int dice_value, Move moves[MAX_MOVES]) {
+    const Player* player = &game->players[player_id];
+    int count = 0;
+    
+    for(int i = 0; i < player->num_tokens; i++) {
+        if(player->token_positions[i] == -1 && dice_value == 6) {
+            describe_move(game, player, i, dice_value, true, &moves[count++]);
+        } else if(player->token_positions[i] >= 0 && can_move_token(game, player, i, dice_value)) {
+            describe_move(game, player, i, dice_value, false, &moves[count++]);
+        }
+    }
+    
+    if(count == 0 && game->team_mode && !(game->rules & RULE_NO_TEAM_SHARE) &&
+       player->home_tokens == player->num_tokens) {
+        for(int p = 0; p < NUM_PLAYERS; p++) {
+            const Player* teammate = &game->players[p];
+            if(p == player_id || !are_teammates(game, player_id, p) || teammate->is_active) continue;
+            
+            for(int i = 0; i < teammate->num_tokens; i++) {
+                if(can_move_token(game, teammate, i, dice_value)) {
+                    // Like play_token, this uses move_token even for a token in the yard
+                    describe_move(game, teammate, i, dice_value, false, &moves[count]);
+                    moves[count++].flags |= MOVE_TEAMMATE;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+bool check_win(Game* game, Player* player) {
+    if(!game->team_mode) {
+        return player->home_tokens == player->num_tokens;
+    }
+    
+    // In team mode, check if both players in the team have finished
+    if(player->home_tokens == player->num_tokens) {
+        for(int i = 0; i < 2; i++) {
+            if(game->teams[i].player1_id == player->id || game->teams[i].player2_id == player->id) {
+                int teammate_id = (game->teams[i].player1_id == player->id) ? 
+                                 game->teams[i].player2_id : game->teams[i].player1_id;
+                
+                // Only count as a win if both players have finished
+                if(game->players[teammate_id].home_tokens == game->players[teammate_id].num_tokens && 
+                   player->home_tokens == player->num_tokens) {
+                    // Set both players as inactive
                     player->is_active = false;
-                    players[teammate_id].is_active = false;
+                    game->players[teammate_id].is_active = false;
                     
                     // Assign ranks if not already assigned
-                    if(player->rank == 0) player->rank = current_rank;
-                    if(players[teammate_id].rank == 0) players[teammate_id].rank = current_rank;
+                    if(player->rank == 0) player->rank = game->current_rank;
+                    if(game->players[teammate_id].rank == 0) game->players[teammate_id].rank = game->current_rank;
                     
                     // Both players on opposing team get the next rank
                     int opposing_team = (i + 1) % 2;
-                    int opp1_id = teams[opposing_team].player1_id;
-                    int opp2_id = teams[opposing_team].player2_id;
+                    int opp1_id = game->teams[opposing_team].player1_id;
+                    int opp2_id = game->teams[opposing_team].player2_id;
                     
                     // Only assign ranks to opposing team if they haven't finished yet
-                    if(players[opp1_id].rank == 0) players[opp1_id].rank = current_rank + 1;
-                    if(players[opp2_id].rank == 0) players[opp2_id].rank = current_rank + 1;
+                    if(game->players[opp1_id].rank == 0) game->players[opp1_id].rank = game->current_rank + 1;
+                    if(game->players[opp2_id].rank == 0) game->players[opp2_id].rank = game->current_rank + 1;
                     
                     // End the game only when both players in a team have finished
-                    active_players = 1; // This will trigger game end
-                    printf("\nTeam %d (%s & %s) has won the game!\n", 
-                           i + 1, players[player->id].color, players[teammate_id].color);
+                    game->active_players = 1; // This will trigger game end
+                    GAME_LOG(game, "\nTeam %d (%s & %s) has won the game!\n", 
+                           i + 1, game->players[player->id].color, game->players[teammate_id].color);
                     return true;
                 } else if(player->home_tokens == player->num_tokens) {
                     // If only this player has finished, mark them as inactive but don't end game
                     player->is_active = false;
-                    printf("\nPlayer %s has finished! Waiting for teammate %s to finish...\n",
-                           player->color, players[teammate_id].color);
-                    active_players--;
+                    GAME_LOG(game, "\nPlayer %s has finished! Waiting for teammate %s to finish...\n",
+                           player->color, game->players[teammate_id].color);
+                    game->active_players--;
                     return false;
                 }
-                break;
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+
+// Tokens the player may move with this roll, in token order; returns how many
+int movable_tokens(Game* game, Player* player, int dice_value, int tokens[MAX_TOKENS]) {
+    int count = 0;
+    
+    for(int i = 0; i < player->num_tokens; i++) {
+        if((player->token_positions[i] == -1 && dice_value == 6) ||
+           (player->token_positions[i] >= 0 && can_move_token(game, player, i, dice_value))) {
+            tokens[count++] = i;
+        }
+    }
+    return count;
+}
+
+// The built-in bot: the first token that can move, or -1
+int first_movable_token(Game* game, Player* player, int dice_value) {
+    int tokens[MAX_TOKENS];
+    
+    return movable_tokens(game, player, dice_value, tokens) ? tokens[0] : -1;
+}
+
+// Count a six towards the three-sixes rule; returns true if the turn is forfeited
+bool forfeits_turn(Game* game, Player* player, int dice_value) {
+    if(dice_value == 6 && !(game->rules & RULE_NO_THREE_SIXES)) {
+        player->consecutive_sixes++;
+        if(player->consecutive_sixes == 3) {
+            GAME_LOG(game, "Third consecutive 6! Turn forfeited for Player %s\n", player->color);
+            GAME_EVENT(game, EV_FORFEIT | player->id);
+            player->consecutive_sixes = 0;
+            return true;
+        }
+    } else {
+        player->consecutive_sixes = 0;
+    }
+    return false;
+}
+
+// Play one roll of a player's turn; returns true if the player rolls again
+bool play_roll(Game* game, Player* player, int dice_value) {
+    GAME_LOG(game, "\nPlayer %s rolled: %d\n", player->color, dice_value);
+    
+    if(forfeits_turn(game, player, dice_value)) return false;
+    
+    INSTR_TIMER(movegen_start, game);
+    int token_idx = game->choose_move ? game->choose_move(game, player, dice_value)
+                                      : first_movable_token(game, player, dice_value);
+    INSTR_RECORD(movegen_start, LAT_MOVEGEN);
+    return play_token(game, player, dice_value, token_idx);
+}
+
+// Finish a roll once its token is chosen (-1 for none): move, teammate move,
+// stuck and win checks; returns true if the player rolls again
+bool play_token(Game* game, Player* player, int dice_value, int token_idx) {
+    int teammate_id = -1;
+
+    if(game->team_mode) {
+        for(int i = 0; i < 2; i++) {
+            if(game->teams[i].player1_id == player->id) {
+                teammate_id = game->teams[i].player2_id;
+                break;
+            } else if(game->teams[i].player2_id == player->id) {
+                teammate_id = game->teams[i].player1_id;
+                break;
+            }
+        }
+    }
+    
+    bool moved = false;
+    
+    // Move one of the player's own pieces
+    if(token_idx >= 0 && player->token_positions[token_idx] == -1) {
+        place_token(game, player, token_idx, 0);
+        moved = true;
+        GAME_LOG(game, "Player %s started a new token\n", player->color);
+        player->consecutive_unable_to_move = 0;
+    } else if(token_idx >= 0) {
+        move_token(game, player, token_idx, dice_value);
+        moved = true;
+        GAME_LOG(game, "Player %s moved token %d\n", player->color, token_idx + 1);
+        player->consecutive_unable_to_move = 0;
+    }
+    
+    // If player has finished and rolled a 6, they can move teammate's pieces
+    if(game->team_mode && !(game->rules & RULE_NO_TEAM_SHARE) &&
+       player->home_tokens == player->num_tokens && dice_value == 6) {
+        Player* teammate = (teammate_id != -1) ? &game->players[teammate_id] : NULL;
+        
+        if(teammate && !teammate->is_active) {
+            dice_value = roll_dice(game);  // Roll again for teammate
+            GAME_LOG(game, "\nPlayer %s rolling for teammate %s: %d\n", 
+                     player->color, teammate->color, dice_value);
+            
+            for(int i = 0; i < teammate->num_tokens; i++) {
+                if(can_move_token(game, teammate, i, dice_value)) {
+                    move_token(game, teammate, i, dice_value);
+                    moved = true;
+                    GAME_LOG(game, "Player %s moved teammate %s's token %d\n", 
+                             player->color, teammate->color, i + 1);
+                    break;
+                }
+            }
+        }
+    }
+    
+    if(!moved) {
+        GAME_LOG(game, "Player %s couldn't move any token\n", player->color);
+        GAME_EVENT(game, EV_PASS | player->id);
+        player->consecutive_unable_to_move++;
+        
+        if(player->consecutive_unable_to_move >= STUCK_ROLLS && game->active_players <= 2) {
+            GAME_LOG(game, "\nPlayer %s is stuck and cannot proceed. Game over.\n", player->color);
+            player->is_active = false;
+            player->rank = game->current_rank++;
+            game->active_players--;
+        }
+    }
+    
+    if(check_win(game, player)) {
+        if(game->team_mode && teammate_id != -1) {
+            if(game->players[teammate_id].home_tokens == game->players[teammate_id].num_tokens) {
+                // Both players have finished, end the game
+                player->is_active = false;
+                player->rank = game->current_rank++;
+                game->active_players--;
+                GAME_LOG(game, "\nBoth players in the team have finished!\n");
+                return false;
+            }
+        } else {
+            // Non-team mode or single player finished
+            player->is_active = false;
+            player->rank = game->current_rank++;
+            game->active_players--;
+            return false;
+        }
+    }
+    
+    // If it's not a 6 or player couldn't move, end turn
+    if(!moved || dice_value != 6 || !player->is_active) {
+        return false;
+    }
+    GAME_LOG(game, "\nPlayer %s gets another turn for rolling a 6!\n", player->color);
+    return true;
+}
+
+// Play a roll in place on a game with an undo stack; returns true if the player rolls
+// again. count_six is false when the roll already went through forfeits_turn.
+bool apply_move(Game* game, Player* player, int dice_value, int token_idx, bool count_six) {
+    UndoStack* stack = game->undo;
+    UndoRecord* record = &stack->moves[stack->depth++];
+    
+    record->placements = (uint16_t)stack->placed;
+    record->active_players = (uint8_t)game->active_players;
+    record->current_rank = (uint8_t)game->current_rank;
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        Player* other = &game->players[p];
+        record->players[p].hit_record = other->hit_record;
+        record->players[p].consecutive_unable_to_move = other->consecutive_unable_to_move;
+        record->players[p].home_tokens = (uint8_t)other->home_tokens;
+        record->players[p].consecutive_sixes = (uint8_t)other->consecutive_sixes;
+        record->players[p].rank = (uint8_t)other->rank;
+        record->players[p].is_active = other->is_active;
+    }
+    // A 6 that finishes the player, or comes after it finished, re-rolls for the teammate
+    record->saved_rng = game->team_mode && dice_value == 6;
+    if(record->saved_rng) record->rng = game->rng;
+    
+    if(count_six && forfeits_turn(game, player, dice_value)) return false;
+    return play_token(game, player, dice_value, token_idx);
+}
+
+// Put journaled tokens back newest first, down to the given journal height,
+// without journaling the undo itself
+void undo_placements(Game* game, int height) {
+    UndoStack* stack = game->undo;
+    
+    game->undo = NULL;
+    while(stack->placed > height) {
+        UndoPlacement* entry = &stack->placements[--stack->placed];
+        place_token(game, &game->players[entry->player_id], entry->token_idx, entry->from);
+    }
+    game->undo = stack;
+}
+
+// Take back the last apply_move
+void undo_move(Game* game) {
+    UndoStack* stack = game->undo;
+    UndoRecord* record = &stack->moves[--stack->depth];
+    
+    undo_placements(game, record->placements);
+    
+    game->active_players = record->active_players;
+    game->current_rank = record->current_rank;
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        Player* other = &game->players[p];
+        other->hit_record = record->players[p].hit_record;
+        other->consecutive_unable_to_move = record->players[p].consecutive_unable_to_move;
+        other->home_tokens = record->players[p].home_tokens;
+        other->consecutive_sixes = record->players[p].consecutive_sixes;
+        other->rank = record->players[p].rank;
+        other->is_active = record->players[p].is_active;
+    }
+    if(record->saved_rng) game->rng = record->rng;
+}
+
+// Endgame tablebase. The duel has no move choices, so it is a Markov chain over
+// its states; --solve finds the odds by value iteration on all threads. Token
+// moves come from the engine itself: every position pair and roll is played once
+// through play_token, and the sweeps only add the counters on top.
+
+#define TB_VERSION 2
+#define TB_TOLERANCE 1e-9
+#define TB_MAX_SWEEPS 100000
+
+enum { TB_MOVED, TB_UNABLE, TB_FINISHED };
+
+static const char tablebase_magic[4] = {'L', 'U', 'D', 'T'};
+
+// Where one roll takes the mover's token and the opponent's
+typedef struct {
+    int8_t pos;
+    int8_t opp_pos;
+    uint8_t result;
+} TablebaseStep;
+
+typedef struct {
+    const TablebaseStep* steps;
+    const double* values;
+    double* next;
+    int worker_id;
+    int num_workers;
+    double delta;
+    pthread_t thread_id;
+} TablebaseWorker;
+
+// Arms from seat p's arm forward to seat q's
+#define ARM_DISTANCE(p, q) ((SEAT_ARM(q) - SEAT_ARM(p) + NUM_ARMS) % NUM_ARMS)
+
+// Some pair of seats the given arm distance apart, if the build has one
+static bool tb_seats(int distance, int* mover, int* opponent) {
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        for(int q = 0; q < NUM_PLAYERS; q++) {
+            if(q != p && ARM_DISTANCE(p, q) == distance) {
+                *mover = p;
+                *opponent = q;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// The arm distances between seats of this build, as a bit mask
+static uint32_t tb_distances(void) {
+    uint32_t distances = 0;
+    int seat, opp_seat;
+    for(int offset = 1; offset < NUM_ARMS; offset++) {
+        if(tb_seats(offset, &seat, &opp_seat)) distances |= 1u << offset;
+    }
+    return distances;
+}
+
+static inline size_t tb_index(int offset, int pos, int opp_pos, int sixes, int opp_sixes, int unable, int opp_unable) {
+    size_t i = (size_t)(offset - 1) * TB_POSITIONS + pos + 1;
+    i = i * TB_POSITIONS + opp_pos + 1;
+    i = (i * 3 + sixes) * 3 + opp_sixes;
+    return (i * STUCK_ROLLS + unable) * STUCK_ROLLS + opp_unable;
+}
+
+static inline const TablebaseStep* tb_step(const TablebaseStep* steps, int offset, int pos, int opp_pos, int dice_value) {
+    return &steps[(((offset - 1) * TB_POSITIONS + pos + 1) * TB_POSITIONS + opp_pos + 1) * 6 + dice_value - 1];
+}
+
+// The single token a player has left, or -1 if it has none or several
+static int tb_last_token(const Player* player) {
+    int last = -1;
+    for(int t = 0; t < player->num_tokens; t++) {
+        if(player->token_positions[t] >= PATH_LENGTH) continue;
+        if(last >= 0) return -1;
+        last = t;
+    }
+    return last;
+}
+
+// Exact odds that player_id, about to roll, finishes ahead of the other player left
+bool tablebase_probe(const Game* game, int player_id, double* win) {
+    if(!tablebase.values || game->team_mode || game->rules || game->active_players != 2) return false;
+    
+    const Player* player = &game->players[player_id];
+    const Player* opponent = NULL;
+    for(int i = 1; i < NUM_PLAYERS && !opponent; i++) {
+        const Player* other = &game->players[(player_id + i) % NUM_PLAYERS];
+        if(other->is_active) opponent = other;
+    }
+    if(!player->is_active || !opponent || !player->hit_record || !opponent->hit_record ||
+       player->consecutive_sixes > 2 || opponent->consecutive_sixes > 2 ||
+       player->consecutive_unable_to_move >= STUCK_ROLLS || opponent->consecutive_unable_to_move >= STUCK_ROLLS) {
+        return false;
+    }
+    int token = tb_last_token(player);
+    int opp_token = tb_last_token(opponent);
+    if(token < 0 || opp_token < 0) return false;
+    
+    *win = tablebase.values[tb_index(ARM_DISTANCE(player_id, opponent->id),
+                                     player->token_positions[token], opponent->token_positions[opp_token],
+                                     player->consecutive_sixes, opponent->consecutive_sixes,
+                                     player->consecutive_unable_to_move, opponent->consecutive_unable_to_move)];
+    return true;
+}
+
+// Play every position pair and roll of the duel through the engine
+static void tb_build_steps(TablebaseStep* steps) {
+    Game duel;
+    memset(&duel, 0, sizeof(duel));
+    duel.num_tokens_per_player = 1;
+    
+    for(int offset = 1; offset < NUM_ARMS; offset++) {
+        // The board turns with the seats, so any pair this far apart plays the same duel
+        int seat, opp_seat;
+        if(!tb_seats(offset, &seat, &opp_seat)) continue;
+        reset_game(&duel, 0);
+        duel.rules = 0;  // The table covers the standard rules
+        for(int p = 0; p < NUM_PLAYERS; p++) {
+            if(p == seat || p == opp_seat) continue;
+            place_token(&duel, &duel.players[p], 0, PATH_LENGTH);
+            duel.players[p].home_tokens = 1;
+            duel.players[p].is_active = false;
+            duel.players[p].rank = duel.current_rank++;
+        }
+        duel.active_players = 2;
+        duel.players[seat].hit_record = 1;
+        duel.players[opp_seat].hit_record = 1;
+        Game start = duel;
+        
+        for(int pos = -1; pos < PATH_LENGTH; pos++) {
+            for(int opp_pos = -1; opp_pos < PATH_LENGTH; opp_pos++) {
+                for(int dice_value = 1; dice_value <= 6; dice_value++) {
+                    Game game = start;
+                    Player* mover = &game.players[seat];
+                    Player* opponent = &game.players[opp_seat];
+                    place_token(&game, mover, 0, pos);
+                    place_token(&game, opponent, 0, opp_pos);
+                    play_token(&game, mover, dice_value, first_movable_token(&game, mover, dice_value));
+                    
+                    TablebaseStep* step = (TablebaseStep*)tb_step(steps, offset, pos, opp_pos, dice_value);
+                    step->pos = (int8_t)mover->token_positions[0];
+                    step->opp_pos = (int8_t)opponent->token_positions[0];
+                    step->result = mover->home_tokens == mover->num_tokens ? TB_FINISHED :
+                                   mover->consecutive_unable_to_move ? TB_UNABLE : TB_MOVED;
+                }
+            }
+        }
+    }
+}
+
+// One state, given its position pair's six steps: the mover's odds averaged over
+// the six faces. Whenever the turn passes, the odds are one minus the opponent's
+// from its own view.
+static double tb_update(const TablebaseStep* row, const double* v, int offset, int pos, int opp_pos,
+                        int sixes, int opp_sixes, int unable, int opp_unable) {
+    int back = NUM_ARMS - offset;  // The mover's arm seen from the opponent
+    double sum = 0.0;
+    
+    for(int dice_value = 1; dice_value <= 6; dice_value++) {
+        if(dice_value == 6 && sixes == 2) {
+            // Third 6: the turn is forfeited and the counter starts over
+            sum += 1.0 - v[tb_index(back, opp_pos, pos, opp_sixes, 0, opp_unable, unable)];
+            continue;
+        }
+        int new_sixes = dice_value == 6 ? sixes + 1 : 0;
+        const TablebaseStep* step = &row[dice_value - 1];
+        
+        if(step->result == TB_FINISHED) {
+            sum += 1.0;
+        } else if(step->result == TB_UNABLE) {
+            // The stuck rule ranks the stuck player, which leaves the other one last
+            if(unable + 1 >= STUCK_ROLLS) sum += 1.0;
+            else sum += 1.0 - v[tb_index(back, opp_pos, pos, opp_sixes, new_sixes, opp_unable, unable + 1)];
+        } else if(dice_value == 6) {
+            sum += v[tb_index(offset, step->pos, step->opp_pos, new_sixes, opp_sixes, 0, opp_unable)];
+        } else {
+            sum += 1.0 - v[tb_index(back, step->opp_pos, step->pos, opp_sixes, 0, opp_unable, 0)];
+        }
+    }
+    return sum / 6.0;
+}
+
+// One Jacobi sweep over the worker's share of (offset, position) rows
+static void* tablebase_worker(void* arg) {
+    TablebaseWorker* worker = (TablebaseWorker*)arg;
+    double delta = 0.0;
+    
+    for(int row = worker->worker_id; row < (NUM_ARMS - 1) * TB_POSITIONS; row += worker->num_workers) {
+        int offset = row / TB_POSITIONS + 1;
+        int pos = row % TB_POSITIONS - 1;
+        int seat, opp_seat;
+        if(!tb_seats(offset, &seat, &opp_seat)) continue;
+        for(int opp_pos = -1; opp_pos < PATH_LENGTH; opp_pos++) {
+            const TablebaseStep* row_steps = tb_step(worker->steps, offset, pos, opp_pos, 1);
+            for(int sixes = 0; sixes < 3; sixes++) {
+                for(int opp_sixes = 0; opp_sixes < 3; opp_sixes++) {
+                    for(int unable = 0; unable < STUCK_ROLLS; unable++) {
+                        for(int opp_unable = 0; opp_unable < STUCK_ROLLS; opp_unable++) {
+                            size_t i = tb_index(offset, pos, opp_pos, sixes, opp_sixes, unable, opp_unable);
+                            double value = tb_update(row_steps, worker->values, offset, pos, opp_pos,
+                                                     sixes, opp_sixes, unable, opp_unable);
+                            double change = fabs(value - worker->values[i]);
+                            if(change > delta) delta = change;
+                            worker->next[i] = value;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    worker->delta = delta;
+    return NULL;
+}
+
+int run_solve(const char* path, int num_workers) {
+    TablebaseStep* steps = calloc((size_t)(NUM_ARMS - 1) * TB_POSITIONS * TB_POSITIONS * 6, sizeof(TablebaseStep));
+    double* values = calloc(TB_STATES, sizeof(double));
+    double* next = calloc(TB_STATES, sizeof(double));
+    float* table = calloc(TB_STATES, sizeof(float));
+    TablebaseWorker* workers = calloc(num_workers, sizeof(TablebaseWorker));
+    if(!steps || !values || !next || !table || !workers) {
+        fprintf(stderr, "Out of memory for %zu tablebase states\n", TB_STATES);
+        free(steps);
+        free(values);
+        free(next);
+        free(table);
+        free(workers);
+        return 1;
+    }
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    tb_build_steps(steps);
+    
+    // Start from even odds; every sweep looks one roll further ahead. Unused
+    // distances are never swept, so they stay even in both buffers.
+    for(size_t i = 0; i < TB_STATES; i++) values[i] = next[i] = 0.5;
+    int sweeps = 0;
+    double residual = 1.0;
+    while(residual > TB_TOLERANCE && sweeps < TB_MAX_SWEEPS) {
+        for(int w = 0; w < num_workers; w++) {
+            workers[w] = (TablebaseWorker){ steps, values, next, w, num_workers, 0.0, 0 };
+            pthread_create(&workers[w].thread_id, NULL, tablebase_worker, &workers[w]);
+        }
+        residual = 0.0;
+        for(int w = 0; w < num_workers; w++) {
+            pthread_join(workers[w].thread_id, NULL);
+            if(workers[w].delta > residual) residual = workers[w].delta;
+        }
+        double* swap = values;
+        values = next;
+        next = swap;
+        sweeps++;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    TablebaseHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, tablebase_magic, 4);
+    header.version = TB_VERSION;
+    header.states = TB_STATES;
+    header.sweeps = (uint32_t)sweeps;
+    header.distances = tb_distances();
+    header.residual = residual;
+    for(size_t i = 0; i < TB_STATES; i++) table[i] = (float)values[i];
+    
+    FILE* out = fopen(path, "wb");
+    bool written = out && fwrite(&header, sizeof(header), 1, out) == 1 &&
+                   fwrite(table, sizeof(float), TB_STATES, out) == TB_STATES;
+    if(out && fclose(out) != 0) written = false;
+    if(!written) perror(path);
+    
+    if(written) {
+        printf("Solved %zu duel states in %d sweeps (residual %.1e) on %d thread%s in %.2f s\n",
+               TB_STATES, sweeps, residual, num_workers, num_workers == 1 ? "" : "s", elapsed);
+        printf("Wrote %s: %.1f MB\n", path, (sizeof(header) + TB_STATES * sizeof(float)) / 1e6);
+        static const char* const distance_names[NUM_ARMS] = {"", "next arm", "facing", "previous arm"};
+        const char* separator = ":";
+        printf("Odds of the player to move, both tokens in the yard");
+        for(int offset = 1, seat, opp_seat; offset < NUM_ARMS; offset++) {
+            if(!tb_seats(offset, &seat, &opp_seat)) continue;
+            printf("%s %.4f (%s)", separator, values[tb_index(offset, -1, -1, 0, 0, 0, 0)], distance_names[offset]);
+            separator = ",";
+        }
+        printf("\n");
+    }
+    free(steps);
+    free(values);
+    free(next);
+    free(table);
+    free(workers);
+    return written ? 0 : 1;
+}
+
+int tablebase_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if(fd >= 0) close(fd);
+        return 1;
+    }
+    size_t size = (size_t)st.st_size;
+    void* map = size >= sizeof(TablebaseHeader) ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    
+    const TablebaseHeader* header = map == MAP_FAILED ? NULL : (const TablebaseHeader*)map;
+    if(!header || memcmp(header->magic, tablebase_magic, 4) != 0 || header->version != TB_VERSION ||
+       header->states != TB_STATES || size != sizeof(TablebaseHeader) + TB_STATES * sizeof(float) ||
+       (tb_distances() & ~header->distances) != 0) {
+        fprintf(stderr, "%s is not a tablebase for this build\n", path);
+        if(header) munmap(map, size);
+        return 1;
+    }
+    tablebase.header = header;
+    tablebase.values = (const float*)(header + 1);
+    tablebase.size = size;
+    return 0;
+}
+
+// Expectimax over the dice. The AI seat (and its teammate) maximize, every other
+// seat is assumed to play against it, and chance nodes average the six faces with
+// Star1 pruning. Turn order is modelled as the next active seat; the real order
+// is reshuffled every round.
+
+#define SEARCH_HOME_VALUE 72  // A token at home, against 8 + position on the path
+#define SEARCH_KILL_VALUE 16  // A kill opens the home column
+#define SEARCH_CHECK_EVERY 1024
+
+typedef struct {
+    const SearchConfig* config;
+    int root_id;
+    long nodes;
+    double deadline;  // Monotonic seconds, 0 for none
+    bool aborted;
+} SearchContext;
+
+static const char* search_unit(const SearchConfig* config) {
+    return config->engine == SEARCH_MCTS ? "playouts" : "nodes";
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Progress of one player between 0 (nothing out) and 1 (finished)
+static double search_progress(Player* player) {
+    if(player->home_tokens == player->num_tokens) return 1.0;
+    
+    int score = player->hit_record > 0 ? SEARCH_KILL_VALUE : 0;
+    for(int t = 0; t < player->num_tokens; t++) {
+        int pos = player->token_positions[t];
+        if(pos >= PATH_LENGTH) score += SEARCH_HOME_VALUE;
+        else if(pos >= 0) score += 8 + pos;
+    }
+    return (double)score / (player->num_tokens * SEARCH_HOME_VALUE + SEARCH_KILL_VALUE);
+}
+
+static bool search_side(Game* game, int root_id, int player_id) {
+    return player_id == root_id || (game->team_mode && are_teammates(game, root_id, player_id));
+}
+
+// Mean progress of the root's side minus that of the other side, in [-1, 1]
+static double search_evaluate(Game* game, int root_id) {
+    double own = 0, other = 0;
+    int own_count = 0, other_count = 0;
+    
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        double progress = search_progress(&game->players[p]);
+        if(search_side(game, root_id, p)) {
+            own += progress;
+            own_count++;
+        } else {
+            other += progress;
+            other_count++;
+        }
+    }
+    return own / own_count - other / other_count;
+}
+
+static int search_next_player(Game* game, int player_id) {
+    for(int i = 1; i <= NUM_PLAYERS; i++) {
+        int p = (player_id + i) % NUM_PLAYERS;
+        if(game->players[p].is_active) return p;
+    }
+    return player_id;
+}
+
+static bool search_out_of_budget(SearchContext* ctx) {
+    if(ctx->config->node_budget > 0 && ctx->nodes >= ctx->config->node_budget) return true;
+    return ctx->deadline > 0 && ctx->nodes % SEARCH_CHECK_EVERY == 0 && now_seconds() >= ctx->deadline;
+}
+
+static double search_chance(SearchContext* ctx, Game* game, int player_id, int depth, double alpha, double beta);
+
+// Play one token (or none) for a roll in place, search on, and take it back
+static double search_after(SearchContext* ctx, Game* game, int player_id, int dice_value, int token_idx,
+                           bool count_six, int depth, double alpha, double beta) {
+    bool again = apply_move(game, &game->players[player_id], dice_value, token_idx, count_six);
+    int next = again ? player_id : search_next_player(game, player_id);
+    double value = search_chance(ctx, game, next, depth - 1, alpha, beta);
+    undo_move(game);
+    return value;
+}
+
+// Value of player_id having rolled dice_value
+static double search_roll(SearchContext* ctx, Game* game, int player_id, int dice_value, int depth,
+                          double alpha, double beta) {
+    Player* player = &game->players[player_id];
+    int tokens[MAX_TOKENS];
+    int count = movable_tokens(game, player, dice_value, tokens);
+    
+    // A third six ends the turn whatever the choice (see forfeits_turn)
+    if(count <= 1 || (dice_value == 6 && player->consecutive_sixes == 2 && !(game->rules & RULE_NO_THREE_SIXES))) {
+        return search_after(ctx, game, player_id, dice_value, count ? tokens[0] : -1, true, depth, alpha, beta);
+    }
+    
+    bool maximizing = search_side(game, ctx->root_id, player_id);
+    double best = maximizing ? -1.0 : 1.0;
+    
+    for(int i = 0; i < count && !ctx->aborted; i++) {
+        double value = search_after(ctx, game, player_id, dice_value, tokens[i], true, depth, alpha, beta);
+        
+        if(maximizing) {
+            if(value > best) best = value;
+            if(best > alpha) alpha = best;
+        } else {
+            if(value < best) best = value;
+            if(best < beta) beta = best;
+        }
+        if(alpha >= beta) break;
+    }
+    return best;
+}
+
+// Value of player_id about to roll, averaged over the six faces (Star1)
+static double search_chance(SearchContext* ctx, Game* game, int player_id, int depth, double alpha, double beta) {
+    ctx->nodes++;
+    if(search_out_of_budget(ctx)) ctx->aborted = true;
+    if(ctx->aborted) return 0.0;
+    
+    if(depth <= 0 || game->active_players <= 1 || !game->players[ctx->root_id].is_active) {
+        return search_evaluate(game, ctx->root_id);
+    }
+    
+    // A duel in the tablebase needs no search: both sides are the root and its opponent
+    double win;
+    if(tablebase_probe(game, player_id, &win)) {
+        return player_id == ctx->root_id ? 2.0 * win - 1.0 : 1.0 - 2.0 * win;
+    }
+    
+    double sum = 0.0;
+    for(int face = 1; face <= 6; face++) {
+        // Window for this face given the faces seen so far and the bounds on the rest
+        double low = 6.0 * alpha - sum - 1.0 * (6 - face);
+        double high = 6.0 * beta - sum + 1.0 * (6 - face);
+        double value = search_roll(ctx, game, player_id, face, depth,
+                                   low > -1.0 ? low : -1.0, high < 1.0 ? high : 1.0);
+        if(value <= low) return alpha;
+        if(value >= high) return beta;
+        sum += value;
+    }
+    return sum / 6.0;
+}
+
+// Iterative deepening over the root moves until the depth, node or time budget runs out
+static int expectimax_search(Game* root, int player_id, int dice_value, int* tokens, int count,
+                             const SearchConfig* config, double start, long* nodes, int* completed) {
+    SearchContext ctx = { config, player_id, 0, 0.0, false };
+    if(config->time_budget_ms > 0) ctx.deadline = start + config->time_budget_ms / 1000.0;
+    
+    // The whole search runs in place on root, one undo record per roll of look-ahead
+    UndoStack stack;
+    stack.depth = 0;
+    stack.placed = 0;
+    root->undo = &stack;
+    
+    int max_depth = config->max_depth < UNDO_MAX_MOVES ? config->max_depth : UNDO_MAX_MOVES;
+    int best_token = tokens[0];
+    for(int depth = 1; depth <= max_depth; depth++) {
+        int iteration_best = tokens[0];
+        double alpha = -1.0;
+        
+        for(int i = 0; i < count && !ctx.aborted; i++) {
+            // The root roll already went through forfeits_turn in play_roll
+            double value = search_after(&ctx, root, player_id, dice_value, tokens[i], false, depth, alpha, 1.0);
+            if(i == 0 || value > alpha) {
+                alpha = value;
+                iteration_best = tokens[i];
+            }
+        }
+        if(ctx.aborted) break;
+        best_token = iteration_best;
+        *completed = depth;
+    }
+    root->undo = NULL;
+    *nodes = ctx.nodes;
+    return best_token;
+}
+
+// Monte Carlo tree search, shared by several threads without locks. Chance nodes
+// have a child per dice face; decision nodes have a child per token plus one for
+// "no move". Nodes hold no state: a playout replays its path on a copy of the root.
+// Visit and value counters are atomics, and a thread descending through a move adds
+// a virtual loss so the others spread out until its result is backed up.
+
+#define MCTS_MAX_NODES (1 << 20)
+#define MCTS_MAX_PATH 256
+#define MCTS_ROLLOUT_ROLLS 120  // Random rolls before a playout is scored by search_evaluate
+#define MCTS_VIRTUAL_LOSS 3
+#define MCTS_SCALE 1000000  // Rewards are summed as fixed point
+#define MCTS_EXPLORATION 0.7
+#define MCTS_DEFAULT_PLAYOUTS 10000
+
+typedef struct {
+    _Atomic int32_t visits;    // Finished playouts plus virtual losses in flight
+    _Atomic int32_t children;  // First child, 0 until expanded, -1 while expanding or when the pool is full
+    _Atomic int64_t value;     // Reward of the player who made the move into this node
+} MctsNode;
+
+typedef struct {
+    MctsNode* nodes;
+    _Atomic int32_t used;
+    _Atomic long playouts;
+    _Atomic int max_path;
+    long playout_budget;
+    double deadline;   // Monotonic seconds, 0 for none
+    const Game* root;  // Silent copy of the game with the root player's roll pending
+    int root_id;
+    int dice_value;
+} MctsTree;
+
+typedef struct {
+    MctsTree* tree;
+    uint64_t seed;
+    pthread_t thread_id;
+} MctsWorker;
+
+// A parked MCTS thread of an arena, woken once per search
+typedef struct {
+    MctsWorker worker;
+    SearchArena* arena;
+    sem_t go;
+} MctsHelper;
+
+// Memory and threads a searching thread keeps from move to move and game to game:
+// the MCTS node pool and the helpers that grow the tree beside it. Allocated by
+// the first search that needs them, so steady play neither allocates nor spawns.
+// Searches on one arena must not overlap; every searching thread gets its own.
+struct SearchArena {
+    MctsNode* nodes;       // MCTS_MAX_NODES nodes, NULL until the first MCTS search
+    MctsHelper* helpers;
+    int num_helpers;
+    sem_t done;            // Posted by each helper when its part of a search ends
+    bool stopping;         // Set before waking the helpers to make them exit
+};
+
+// Children of a node, creating them on first use (*fresh is then set); returns the
+// first child index, or <= 0 to treat the node as a leaf
+static int32_t mcts_expand(MctsTree* tree, MctsNode* node, int count, bool* fresh) {
+    int32_t first = atomic_load_explicit(&node->children, memory_order_acquire);
+    if(first != 0) return first;
+    if(!atomic_compare_exchange_strong(&node->children, &first, -1)) return first;
+    
+    *fresh = true;
+    first = atomic_fetch_add(&tree->used, count);
+    if(first + count > MCTS_MAX_NODES) return -1;
+    
+    for(int i = 0; i < count; i++) {
+        atomic_init(&tree->nodes[first + i].visits, 0);
+        atomic_init(&tree->nodes[first + i].children, 0);
+        atomic_init(&tree->nodes[first + i].value, 0);
+    }
+    atomic_store_explicit(&node->children, first, memory_order_release);
+    return first;
+}
+
+// UCT over the legal children; unvisited children go first
+static int mcts_select(MctsTree* tree, int32_t first, int32_t parent_visits, int* tokens, int count) {
+    double log_parent = log((double)(parent_visits > 0 ? parent_visits : 1));
+    double best_score = -1.0;
+    int best = tokens[0];
+    
+    for(int i = 0; i < count; i++) {
+        MctsNode* child = &tree->nodes[first + tokens[i]];
+        int32_t visits = atomic_load_explicit(&child->visits, memory_order_relaxed);
+        if(visits <= 0) return tokens[i];
+        
+        double mean = (double)atomic_load_explicit(&child->value, memory_order_relaxed) / MCTS_SCALE / visits;
+        double score = mean + MCTS_EXPLORATION * sqrt(log_parent / visits);
+        if(score > best_score) {
+            best_score = score;
+            best = tokens[i];
+        }
+    }
+    return best;
+}
+
+// Play a random legal token for a roll; returns true if the player rolls again
+static bool mcts_random_move(Game* game, Player* player, int dice_value) {
+    int tokens[MAX_TOKENS];
+    int count = movable_tokens(game, player, dice_value, tokens);
+    return play_token(game, player, dice_value, count ? tokens[rng_below(&game->rng, count)] : -1);
+}
+
+static bool mcts_random_roll(Game* game, Player* player, int dice_value) {
+    if(forfeits_turn(game, player, dice_value)) return false;
+    return mcts_random_move(game, player, dice_value);
+}
+
+// Reward of one seat at the end of a playout: 1 for first place down to 0 for last,
+// or its lead over the other side if the playout was cut short
+static double mcts_reward(Game* game, int player_id) {
+    Player* player = &game->players[player_id];
+    
+    if(game->active_players > 1) return (1.0 + search_evaluate(game, player_id)) / 2.0;
+    if(player->rank == 0) return 0.0;
+    
+    double reward = (double)(NUM_PLAYERS - player->rank) / (NUM_PLAYERS - 1);
+    return reward > 0 ? reward : 0.0;
+}
+
+static void mcts_playout(MctsTree* tree, Rng* rng) {
+    Game game = *tree->root;
+    int32_t path[MCTS_MAX_PATH];
+    int8_t mover[MCTS_MAX_PATH];
+    int depth = 0;
+    
+    MctsNode* node = &tree->nodes[0];
+    int player_id = tree->root_id;
+    int dice_value = tree->dice_value;
+    bool decision = true;   // node is a decision node with dice_value rolled
+    bool pending = true;    // dice_value has not been played yet
+    bool root = true;       // The root roll was already counted for the sixes rule
+    
+    game.rng = *rng;
+    while(depth < MCTS_MAX_PATH && game.active_players > 1) {
+        Player* player = &game.players[player_id];
+        bool fresh = false;
+        int32_t first;
+        
+        if(decision) {
+            first = mcts_expand(tree, node, player->num_tokens + 1, &fresh);
+            if(first <= 0) break;
+            
+            int tokens[MAX_TOKENS];
+            bool forfeited = !root && forfeits_turn(&game, player, dice_value);
+            int count = forfeited ? 0 : movable_tokens(&game, player, dice_value, tokens);
+            int choice = count == 0 ? player->num_tokens :
+                         count == 1 ? tokens[0] :
+                         mcts_select(tree, first, atomic_load_explicit(&node->visits, memory_order_relaxed),
+                                     tokens, count);
+            
+            node = &tree->nodes[first + choice];
+            atomic_fetch_add_explicit(&node->visits, MCTS_VIRTUAL_LOSS, memory_order_relaxed);
+            path[depth] = first + choice;
+            mover[depth++] = (int8_t)player_id;
+            
+            bool again = !forfeited && play_token(&game, player, dice_value, count ? choice : -1);
+            if(!again) player_id = search_next_player(&game, player_id);
+            decision = false;
+            pending = false;
+            root = false;
+        } else {
+            // A chance node reached for the first time is the leaf this playout adds
+            first = mcts_expand(tree, node, 6, &fresh);
+            if(first <= 0 || fresh) break;
+            
+            dice_value = roll_dice(&game);
+            node = &tree->nodes[first + dice_value - 1];
+            atomic_fetch_add_explicit(&node->visits, MCTS_VIRTUAL_LOSS, memory_order_relaxed);
+            path[depth] = first + dice_value - 1;
+            mover[depth++] = -1;
+            decision = true;
+            pending = true;
+        }
+    }
+    
+    // Finish the game with random moves, starting with a roll the tree left unplayed
+    if(pending && game.active_players > 1) {
+        Player* player = &game.players[player_id];
+        bool again = root ? mcts_random_move(&game, player, dice_value)
+                          : mcts_random_roll(&game, player, dice_value);
+        if(!again) player_id = search_next_player(&game, player_id);
+    }
+    double win = 0.0;
+    bool exact = false;
+    for(int rolls = 0; rolls < MCTS_ROLLOUT_ROLLS && game.active_players > 1; rolls++) {
+        if((exact = tablebase_probe(&game, player_id, &win))) break;
+        if(!mcts_random_roll(&game, &game.players[player_id], roll_dice(&game))) {
+            player_id = search_next_player(&game, player_id);
+        }
+    }
+    
+    int64_t rewards[NUM_PLAYERS];
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        rewards[p] = (int64_t)(mcts_reward(&game, p) * MCTS_SCALE);
+    }
+    if(exact) {
+        // The duellists take the next rank by their exact odds instead of a rollout
+        double rank_reward = (double)(NUM_PLAYERS - game.current_rank) / (NUM_PLAYERS - 1);
+        rewards[player_id] = (int64_t)(win * rank_reward * MCTS_SCALE);
+        rewards[search_next_player(&game, player_id)] = (int64_t)((1.0 - win) * rank_reward * MCTS_SCALE);
+    }
+    
+    atomic_fetch_add_explicit(&tree->nodes[0].visits, 1, memory_order_relaxed);
+    for(int i = 0; i < depth; i++) {
+        MctsNode* n = &tree->nodes[path[i]];
+        atomic_fetch_add_explicit(&n->visits, 1 - MCTS_VIRTUAL_LOSS, memory_order_relaxed);
+        if(mover[i] >= 0) atomic_fetch_add_explicit(&n->value, rewards[(int)mover[i]], memory_order_relaxed);
+    }
+    
+    int longest = atomic_load_explicit(&tree->max_path, memory_order_relaxed);
+    while(depth > longest && !atomic_compare_exchange_weak(&tree->max_path, &longest, depth));
+    *rng = game.rng;
+}
+
+static void* mcts_worker(void* arg) {
+    MctsWorker* worker = (MctsWorker*)arg;
+    MctsTree* tree = worker->tree;
+    Rng rng;
+    
+    rng_seed(&rng, worker->seed);
+    for(long n = 0; ; n++) {
+        if(tree->deadline > 0 && n % 16 == 0 && now_seconds() >= tree->deadline) break;
+        if(atomic_fetch_add(&tree->playouts, 1) >= tree->playout_budget) break;
+        mcts_playout(tree, &rng);
+    }
+    return NULL;
+}
+
+static void* mcts_helper(void* arg) {
+    MctsHelper* helper = (MctsHelper*)arg;
+    SearchArena* arena = helper->arena;
+    
+    while(true) {
+        while(sem_wait(&helper->go) != 0);
+        if(arena->stopping) return NULL;
+        mcts_worker(&helper->worker);
+        sem_post(&arena->done);
+    }
+}
+
+// Stop the arena's helpers and free its memory; the arena can be used again after
+void search_arena_release(SearchArena* arena) {
+    if(arena->helpers) {
+        arena->stopping = true;
+        for(int i = 0; i < arena->num_helpers; i++) {
+            sem_post(&arena->helpers[i].go);
+        }
+        for(int i = 0; i < arena->num_helpers; i++) {
+            pthread_join(arena->helpers[i].worker.thread_id, NULL);
+            sem_destroy(&arena->helpers[i].go);
+        }
+        sem_destroy(&arena->done);
+        free(arena->helpers);
+    }
+    free(arena->nodes);
+    memset(arena, 0, sizeof(*arena));
+}
+
+// Make sure the arena has its node pool and count parked helpers; false if it cannot
+static bool search_arena_reserve(SearchArena* arena, int count) {
+    if(arena->helpers && arena->num_helpers != count) {
+        MctsNode* nodes = arena->nodes;
+        arena->nodes = NULL;
+        search_arena_release(arena);
+        arena->nodes = nodes;
+    }
+    if(!arena->nodes) {
+        arena->nodes = malloc(MCTS_MAX_NODES * sizeof(MctsNode));
+        if(!arena->nodes) return false;
+    }
+    if(count == 0 || arena->helpers) return true;
+    
+    arena->helpers = calloc(count, sizeof(MctsHelper));
+    if(!arena->helpers) return false;
+    sem_init(&arena->done, 0, 0);
+    arena->stopping = false;
+    for(int i = 0; i < count; i++) {
+        MctsHelper* helper = &arena->helpers[i];
+        helper->arena = arena;
+        sem_init(&helper->go, 0, 0);
+        if(pthread_create(&helper->worker.thread_id, NULL, mcts_helper, helper) != 0) {
+            sem_destroy(&helper->go);
+            break;
+        }
+        arena->num_helpers++;
+    }
+    if(arena->num_helpers < count) {
+        search_arena_release(arena);
+        return false;
+    }
+    return true;
+}
+
+// Grow one tree from the root roll on every search thread; the most visited legal move wins
+static int mcts_search(Game* root, int player_id, int dice_value, int* tokens, int count,
+                       const SearchConfig* config, double start, long* playouts, int* depth) {
+    MctsTree tree;
+    int num_threads = config->threads > 0 ? config->threads : 1;
+    MctsWorker workers[num_threads];
+    SearchArena* arena = root->arena && search_arena_reserve(root->arena, num_threads - 1) ? root->arena : NULL;
+    
+    tree.nodes = arena ? arena->nodes : malloc(MCTS_MAX_NODES * sizeof(MctsNode));
+    if(!tree.nodes) return tokens[0];
+    atomic_init(&tree.nodes[0].visits, 0);
+    atomic_init(&tree.nodes[0].children, 0);
+    atomic_init(&tree.nodes[0].value, 0);
+    atomic_init(&tree.used, 1);
+    atomic_init(&tree.playouts, 0);
+    atomic_init(&tree.max_path, 0);
+    tree.playout_budget = config->node_budget > 0 ? config->node_budget :
+                          config->time_budget_ms > 0 ? LONG_MAX : MCTS_DEFAULT_PLAYOUTS;
+    tree.deadline = config->time_budget_ms > 0 ? start + config->time_budget_ms / 1000.0 : 0.0;
+    tree.root = root;
+    tree.root_id = player_id;
+    tree.dice_value = dice_value;
+    
+    for(int i = 0; i < num_threads; i++) {
+        MctsWorker* worker = arena && i > 0 ? &arena->helpers[i - 1].worker : &workers[i];
+        worker->tree = &tree;
+        worker->seed = root->position_hash ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1));
+        if(i == 0) continue;
+        if(arena) sem_post(&arena->helpers[i - 1].go);
+        else pthread_create(&worker->thread_id, NULL, mcts_worker, worker);
+    }
+    mcts_worker(&workers[0]);
+    for(int i = 1; i < num_threads; i++) {
+        if(arena) while(sem_wait(&arena->done) != 0);
+        else pthread_join(workers[i].thread_id, NULL);
+    }
+    
+    int best_token = tokens[0];
+    int32_t first = atomic_load(&tree.nodes[0].children);
+    if(first > 0) {
+        int32_t best_visits = -1;
+        for(int i = 0; i < count; i++) {
+            int32_t visits = atomic_load(&tree.nodes[first + tokens[i]].visits);
+            if(visits > best_visits) {
+                best_visits = visits;
+                best_token = tokens[i];
+            }
+        }
+    }
+    
+    *playouts = atomic_load(&tree.nodes[0].visits);
+    *depth = atomic_load(&tree.max_path);
+    if(!arena) free(tree.nodes);
+    return best_token;
+}
+
+// Pick the token for an AI seat with the configured engine
+int search_move(Game* game, Player* player, int dice_value) {
+    const SearchConfig* config = game->search;
+    if(!config || !((config->players >> player->id) & 1)) {
+        return first_movable_token(game, player, dice_value);
+    }
+    
+    int tokens[MAX_TOKENS];
+    int count = movable_tokens(game, player, dice_value, tokens);
+    if(count <= 1) return count ? tokens[0] : -1;
+    
+    // Search a silent private copy; its dice stream must not follow the real one
+    Game root = *game;
+    root.verbose = false;
+    root.shared = false;
+    root.replay = NULL;
+    root.events = NULL;
+    root.next_roll = NULL;
+    root.choose_move = NULL;
+    rng_seed(&root.rng, game->position_hash ^ (uint64_t)dice_value);
+    
+    double start = now_seconds();
+    long nodes = 0;
+    int depth = 0;
+    int best_token = config->engine == SEARCH_MCTS
+        ? mcts_search(&root, player->id, dice_value, tokens, count, config, start, &nodes, &depth)
+        : expectimax_search(&root, player->id, dice_value, tokens, count, config, start, &nodes, &depth);
+    
+    double elapsed = now_seconds() - start;
+    game->search_stats.moves++;
+    game->search_stats.nodes += nodes;
+    game->search_stats.depth_sum += depth;
+    game->search_stats.seconds += elapsed;
+    GAME_LOG(game, "[AI] Player %s picks token %d: depth %d, %ld %s, %.0f %s/sec\n",
+             player->color, best_token + 1, depth, nodes, search_unit(config),
+             elapsed > 0 ? nodes / elapsed : 0.0, search_unit(config));
+    return best_token;
+}
+
+// One line of search totals, for the end of a game or tournament
+void print_search_stats(const SearchConfig* config, SearchStats* stats) {
+    printf("\nAI seats:");
+    for(int i = 0; i < NUM_PLAYERS; i++) {
+        if((config->players >> i) & 1) printf(" %s", arm_colors[SEAT_ARM(i)]);
+    }
+    if(config->engine == SEARCH_MCTS) {
+        printf(" (mcts, %d thread%s)", config->threads, config->threads == 1 ? "" : "s");
+    }
+    printf(" | %ld moves searched, %ld %s, avg depth %.1f, %.0f %s/sec\n",
+           stats->moves, stats->nodes, search_unit(config),
+           stats->moves ? (double)stats->depth_sum / stats->moves : 0.0,
+           stats->seconds > 0 ? stats->nodes / stats->seconds : 0.0, search_unit(config));
+}
+
+#ifdef LUDO_INSTRUMENT
+// Upper bound of the bucket holding the q-th quantile of a latency histogram
+static long latency_quantile(const LatencyHistogram* h, double q) {
+    long rank = (long)ceil(q * h->count), seen = 0;
+    for(int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if(seen >= rank && seen > 0) return (1L << b) < h->max_ns ? (1L << b) : h->max_ns;
+    }
+    return h->max_ns;
+}
+
+// The interactive game's instrumentation as one JSON object
+void print_instrumentation(FILE* out, const char* scheduler_name) {
+    static const char* latency_names[NUM_LATENCIES] = {"turn", "roll", "move_generation", "hit_check", "render"};
+    static const char* lock_names[NUM_LOCKS] = {"board_mutex", "dice_mutex", "turn_mutex", "dice_semaphore", "board_semaphore"};
+    
+    fprintf(out, "{\n  \"scheduler\": \"%s\",\n  \"latency_ns\": {\n", scheduler_name);
+    for(int i = 0; i < NUM_LATENCIES; i++) {
+        const LatencyHistogram* h = &instrumentation.latency[i];
+        int last = LATENCY_BUCKETS - 1;
+        while(last > 0 && h->buckets[last] == 0) last--;
+        
+        fprintf(out, "    \"%s\": {\"count\": %ld, \"mean\": %.0f, \"p50\": %ld, \"p99\": %ld, \"max\": %ld, \"buckets\": [",
+                latency_names[i], h->count, h->count ? (double)h->total_ns / h->count : 0.0,
+                latency_quantile(h, 0.50), latency_quantile(h, 0.99), h->max_ns);
+        for(int b = 0; b <= last; b++) {
+            fprintf(out, "%s%ld", b ? ", " : "", h->buckets[b]);
+        }
+        fprintf(out, "]}%s\n", i + 1 < NUM_LATENCIES ? "," : "");
+    }
+    fprintf(out, "  },\n  \"locks\": {\n");
+    for(int i = 0; i < NUM_LOCKS; i++) {
+        const LockCounters* c = &instrumentation.locks[i];
+        fprintf(out, "    \"%s\": {\"acquisitions\": %ld, \"contended\": %ld, \"wait_ns\": %ld}%s\n",
+                lock_names[i], c->acquisitions, c->contended, c->wait_ns, i + 1 < NUM_LOCKS ? "," : "");
+    }
+    fprintf(out, "  },\n  \"wakeups\": {\"player_threads\": %ld, \"cond_wait\": %ld, \"wasted\": %ld}\n}\n",
+            scheduler.wakeups, instrumentation.cond_wakeups, instrumentation.wasted_wakeups);
+}
+#endif
+
+// Play out one player's turn on the shared game: roll, move, draw, and roll again on a 6
+void take_turn(Game* game, Player* player) {
+    bool continue_turn = true;
+    INSTR_TURN_BEGIN(game);
+    record_turn(game, player->id);
+    while(continue_turn && player->is_active) {
+        WAIT_SEM(&dice_semaphore, LOCK_DICE_SEM);
+        INSTR_TIMER(roll_start, game);
+        int dice_value = roll_dice(game);
+        INSTR_RECORD(roll_start, LAT_ROLL);
+        sem_post(&dice_semaphore);
+        
+        WAIT_SEM(&board_semaphore, LOCK_BOARD_SEM);
+        continue_turn = play_roll(game, player, dice_value);
+        sem_post(&board_semaphore);
+        
+        INSTR_TIMER(render_start, game);
+        display_board(game);
+        INSTR_RECORD(render_start, LAT_RENDER);
+        
+        if(game->active_players > 1) TURN_PACE(turn_delay_ticks);
+    }
+    game->turn_count++;
+    INSTR_TURN_END();
+    if(game->active_players <= 1) sem_post(&scheduler.game_over);
+}
+
+// Shuffle the seating for a new round and announce it
+static void start_round(Game* game) {
+    lock_dice(game);
+    for(int i = NUM_PLAYERS - 1; i > 0; i--) {
+        int j = rng_below(&game->rng, i + 1);
+        int temp = scheduler.order[i];
+        scheduler.order[i] = scheduler.order[j];
+        scheduler.order[j] = temp;
+    }
+    unlock_dice(game);
+    
+    scheduler.position = 0;
+    scheduler.round++;
+    
+    GAME_LOG(game, "\n--- Round %d order:", scheduler.round);
+    for(int i = 0; i < NUM_PLAYERS; i++) {
+        if(game->players[scheduler.order[i]].is_active) {
+            GAME_LOG(game, " %s", game->players[scheduler.order[i]].color);
+        }
+    }
+    GAME_LOG(game, " ---\n");
+}
+
+// Pass the turn straight to the next active player in this round's order,
+// reshuffling when the round is over; at game end every thread is released
+static void hand_off_turn(Game* game) {
+    if(game->active_players <= 1) {
+        for(int i = 0; i < NUM_PLAYERS; i++) {
+            sem_post(&scheduler.slot[i]);
+        }
+        return;
+    }
+    
+    do {
+        if(++scheduler.position == NUM_PLAYERS) start_round(game);
+    } while(!game->players[scheduler.order[scheduler.position]].is_active);
+    
+    sem_post(&scheduler.slot[scheduler.order[scheduler.position]]);
+}
+
+// Player thread under the hand-off scheduler: sleep on our own slot until the
+// previous player hands us the turn, so each turn wakes exactly one thread
+void* player_turn(void* arg) {
+    Player* player = (Player*)arg;
+    Game* game = &live_game;
+    
+    while(true) {
+        sem_wait(&scheduler.slot[player->id]);
+        scheduler.wakeups++;
+        
+        if(!player->is_active || game->active_players <= 1) break;
+        
+        take_turn(game, player);
+        hand_off_turn(game);
+        
+        if(!player->is_active) break;
+    }
+    
+    return NULL;
+}
+
+// Original scheduling: every player races for turn_mutex and the broadcast
+// after each turn wakes all of them, so the OS picks who goes next
+void* player_turn_broadcast(void* arg) {
+    Player* player = (Player*)arg;
+    Game* game = &live_game;
+    
+    while(player->is_active && game->active_players > 1) {
+        LOCK_MUTEX(&turn_mutex, LOCK_TURN);
+        scheduler.wakeups++;
+        while(previous_turn == player->id) {
+            pthread_cond_wait(&turn_cond, &turn_mutex);
+            scheduler.wakeups++;
+            INSTR_COUNT(cond_wakeups);
+            if(previous_turn == player->id) INSTR_COUNT(wasted_wakeups);
+        }
+        
+        take_turn(game, player);
+        
+        previous_turn = player->id;
+        pthread_cond_broadcast(&turn_cond);
+        pthread_mutex_unlock(&turn_mutex);
+        
+        clock_wait(&game_clock, turn_delay_ticks);
+    }
+    
+    return NULL;
+}
+
+static long context_switches(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+// Play one game to the end on the calling thread, as fast as the CPU allows
+void play_game(Game* game, int max_turns) {
+    int order[NUM_PLAYERS];
+    deal_turn_order(game, order);
+    
+    while(game->active_players > 1 && game->turn_count < max_turns) {
+        for(int i = 0; i < NUM_PLAYERS && game->active_players > 1; i++) {
+            Player* player = &game->players[order[i]];
+            if(!player->is_active) continue;
+            
+            record_turn(game, player->id);
+            while(play_roll(game, player, roll_dice(game)));
+            game->turn_count++;
+        }
+    }
+}
+
+// Batched kernel: BATCH_LANES independent games stored structure-of-arrays, one
+// game per 32-bit lane, each advanced one roll per step with AVX2. A step rolls
+// the dice, applies the three-sixes rule, picks the first movable token exactly as
+// can_move_token would, moves it (yard entry, loop-back, home entry) and resolves
+// captures against every opposing token like check_hits. The rare rolls that end
+// a player (finishing move, stuck rule) are played by the scalar engine on that lane.
+
+#define BATCH_LANES 8
+#define BATCH_ROWS (NUM_PLAYERS * MAX_TOKENS)
+
+typedef struct {
+    int32_t pos[BATCH_ROWS][BATCH_LANES];   // Row player * MAX_TOKENS + token: relative position
+    int32_t cell[BATCH_ROWS][BATCH_LANES];  // Ring cell of the token, -1 in the yard or past the ring
+    int32_t hits[NUM_PLAYERS][BATCH_LANES];
+    int32_t home[NUM_PLAYERS][BATCH_LANES];
+    int32_t sixes[NUM_PLAYERS][BATCH_LANES];
+    int32_t unable[NUM_PLAYERS][BATCH_LANES];
+    int32_t active[NUM_PLAYERS][BATCH_LANES];
+    int32_t rank[NUM_PLAYERS][BATCH_LANES];
+    int32_t active_players[BATCH_LANES];
+    int32_t mover[BATCH_LANES];             // Player to roll, -1 once the lane's game is over
+    uint64_t rng[4][BATCH_LANES];           // xoshiro256** state word by lane
+    
+    // Scalar turn bookkeeping
+    int current_rank[BATCH_LANES];
+    int turn_count[BATCH_LANES];
+    int order[BATCH_LANES][NUM_PLAYERS];
+    int slot[BATCH_LANES];                  // Index into order of the player rolling
+    int game_index[BATCH_LANES];            // -1 for an empty lane
+    int32_t again[BATCH_LANES];             // Step result: the mover rolls again
+    int32_t fallback[BATCH_LANES];          // Step result: dice value left for the scalar engine, 0 if none
+} GameBatch;
+
+// Deal the seating order of a headless game from its dice stream
+void deal_turn_order(Game* game, int order[NUM_PLAYERS]) {
+    for(int i = 0; i < NUM_PLAYERS; i++) {
+        order[i] = i;
+    }
+    for(int i = NUM_PLAYERS - 1; i > 0; i--) {
+        int j = rng_below(&game->rng, i + 1);
+        int temp = order[i];
+        order[i] = order[j];
+        order[j] = temp;
+    }
+}
+
+// Copy a game into a lane
+void batch_load_lane(GameBatch* b, int lane, Game* game) {
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        Player* player = &game->players[p];
+        for(int t = 0; t < MAX_TOKENS; t++) {
+            int pos = t < player->num_tokens ? player->token_positions[t] : PATH_LENGTH;
+            b->pos[p * MAX_TOKENS + t][lane] = pos;
+            b->cell[p * MAX_TOKENS + t][lane] = pos >= 0 && pos < PATH_LENGTH ? ring_cell(p, pos) : -1;
+        }
+        b->hits[p][lane] = player->hit_record;
+        b->home[p][lane] = player->home_tokens;
+        b->sixes[p][lane] = player->consecutive_sixes;
+        b->unable[p][lane] = player->consecutive_unable_to_move;
+        b->active[p][lane] = player->is_active;
+        b->rank[p][lane] = player->rank;
+    }
+    b->active_players[lane] = game->active_players;
+    b->current_rank[lane] = game->current_rank;
+    b->turn_count[lane] = game->turn_count;
+    for(int i = 0; i < 4; i++) {
+        b->rng[i][lane] = game->rng.s[i];
+    }
+}
+
+// Copy a lane back into a game set up with the same tokens and team mode
+void batch_store_lane(GameBatch* b, int lane, Game* game) {
+    reset_players(game);
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        Player* player = &game->players[p];
+        for(int t = 0; t < player->num_tokens; t++) {
+            if(b->pos[p * MAX_TOKENS + t][lane] != -1) place_token(game, player, t, b->pos[p * MAX_TOKENS + t][lane]);
+        }
+        player->hit_record = b->hits[p][lane];
+        player->home_tokens = b->home[p][lane];
+        player->consecutive_sixes = b->sixes[p][lane];
+        player->consecutive_unable_to_move = b->unable[p][lane];
+        player->is_active = b->active[p][lane];
+        player->rank = b->rank[p][lane];
+    }
+    game->active_players = b->active_players[lane];
+    game->current_rank = b->current_rank[lane];
+    game->turn_count = b->turn_count[lane];
+    for(int i = 0; i < 4; i++) {
+        game->rng.s[i] = b->rng[i][lane];
+    }
+}
+
+// Find the lane's next player the way play_game walks its seating order
+static void batch_next_mover(GameBatch* b, int lane, int max_turns) {
+    for(;;) {
+        if(b->active_players[lane] <= 1) break;
+        if(b->slot[lane] == NUM_PLAYERS) {
+            if(b->turn_count[lane] >= max_turns) break;
+            b->slot[lane] = 0;
+        }
+        int p = b->order[lane][b->slot[lane]];
+        if(b->active[p][lane]) {
+            b->mover[lane] = p;
+            return;
+        }
+        b->slot[lane]++;
+    }
+    b->mover[lane] = -1;
+}
+
+// Start a fresh game in a lane; game carries the batch's tokens and team mode
+void batch_start_lane(GameBatch* b, int lane, Game* game, uint64_t seed, int game_index, int max_turns) {
+    reset_game(game, seed);
+    deal_turn_order(game, b->order[lane]);
+    batch_load_lane(b, lane, game);
+    b->game_index[lane] = game_index;
+    b->slot[lane] = NUM_PLAYERS;
+    batch_next_mover(b, lane, max_turns);
+}
+
+// After a step: hand the rolls the kernel left to the scalar engine and move turns on
+static void batch_finish_step(GameBatch* b, Game* scratch, int max_turns) {
+    for(int lane = 0; lane < BATCH_LANES; lane++) {
+        int p = b->mover[lane];
+        if(p < 0) continue;
+        
+        bool again = b->again[lane];
+        if(b->fallback[lane]) {
+            batch_store_lane(b, lane, scratch);
+            again = play_roll(scratch, &scratch->players[p], b->fallback[lane]);
+            batch_load_lane(b, lane, scratch);
+        }
+        if(!again) {
+            b->turn_count[lane]++;
+            b->slot[lane]++;
+            batch_next_mover(b, lane, max_turns);
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define BATCH_HAVE_AVX2 1
+
+__attribute__((target("avx2")))
+static inline __m256i batch_rotl64(__m256i x, int k) {
+    return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+}
+
+// rng_below(rng, 6) + 1 for four lanes' xoshiro256** streams, in the low half of each 64-bit lane
+__attribute__((target("avx2")))
+static inline __m256i batch_roll4(uint64_t* s0, uint64_t* s1, uint64_t* s2, uint64_t* s3) {
+    __m256i a = _mm256_loadu_si256((__m256i*)s0);
+    __m256i b = _mm256_loadu_si256((__m256i*)s1);
+    __m256i c = _mm256_loadu_si256((__m256i*)s2);
+    __m256i d = _mm256_loadu_si256((__m256i*)s3);
+    
+    __m256i x = _mm256_add_epi64(_mm256_slli_epi64(b, 2), b);   // s1 * 5
+    x = batch_rotl64(x, 7);
+    x = _mm256_add_epi64(_mm256_slli_epi64(x, 3), x);           // * 9
+    __m256i t = _mm256_slli_epi64(b, 17);
+    
+    c = _mm256_xor_si256(c, a);
+    d = _mm256_xor_si256(d, b);
+    b = _mm256_xor_si256(b, c);
+    a = _mm256_xor_si256(a, d);
+    c = _mm256_xor_si256(c, t);
+    d = batch_rotl64(d, 45);
+    
+    _mm256_storeu_si256((__m256i*)s0, a);
+    _mm256_storeu_si256((__m256i*)s1, b);
+    _mm256_storeu_si256((__m256i*)s2, c);
+    _mm256_storeu_si256((__m256i*)s3, d);
+    
+    __m256i face = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_set1_epi64x(6)), 32);
+    return _mm256_add_epi64(face, _mm256_set1_epi64x(1));
+}
+
+// Mask of lanes whose ring cell is set in a 64-bit cell mask; shifts of 32 or more give 0
+__attribute__((target("avx2")))
+static inline __m256i batch_cell_in(__m256i cell, uint64_t mask) {
+    __m256i low = _mm256_srlv_epi32(_mm256_set1_epi32((int)(uint32_t)mask), cell);
+    __m256i high = _mm256_srlv_epi32(_mm256_set1_epi32((int)(uint32_t)(mask >> 32)),
+                                     _mm256_sub_epi32(cell, _mm256_set1_epi32(32)));
+    __m256i one = _mm256_set1_epi32(1);
+    return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_or_si256(low, high), one), one);
+}
+
+// The mover's entry of a per-player field: rows[q] in lanes where seat[q] is set
+__attribute__((target("avx2")))
+static inline __m256i batch_select(const int32_t* rows, int stride, const __m256i* seat) {
+    __m256i v = _mm256_setzero_si256();
+    for(int q = 0; q < NUM_PLAYERS; q++) {
+        v = _mm256_or_si256(v, _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(rows + q * stride)), seat[q]));
+    }
+    return v;
+}
+
+// Mask of lanes where v is in [lo, hi]
+__attribute__((target("avx2")))
+static inline __m256i batch_between(__m256i v, int lo, int hi) {
+    return _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(lo), v),
+                                               _mm256_cmpgt_epi32(v, _mm256_set1_epi32(hi))),
+                               _mm256_set1_epi32(-1));
+}
+
+#define LOADV(field) _mm256_loadu_si256((__m256i*)(field))
+#define STOREV(field, v) _mm256_storeu_si256((__m256i*)(field), (v))
+
+// One roll in every lane; results go to b->again and b->fallback
+__attribute__((target("avx2")))
+void batch_step_avx2(GameBatch* b, int num_tokens, bool team_mode) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi32(-1);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i path_length = _mm256_set1_epi32(PATH_LENGTH);
+    
+    __m256i mover = LOADV(b->mover);
+    __m256i running = _mm256_cmpgt_epi32(mover, _mm256_set1_epi32(-1));
+    __m256i p = _mm256_max_epi32(mover, zero);
+    
+    // Dice: two groups of four 64-bit streams, packed down to eight 32-bit lanes
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i lo = _mm256_permutevar8x32_epi32(batch_roll4(&b->rng[0][0], &b->rng[1][0], &b->rng[2][0], &b->rng[3][0]), even);
+    __m256i hi = _mm256_permutevar8x32_epi32(batch_roll4(&b->rng[0][4], &b->rng[1][4], &b->rng[2][4], &b->rng[3][4]), even);
+    __m256i dice = _mm256_permute2x128_si256(lo, hi, 0x20);
+    __m256i six = _mm256_cmpeq_epi32(dice, _mm256_set1_epi32(6));
+    
+    // Per-seat masks stand in for gathers, which are slow on many cores
+    __m256i seat[NUM_PLAYERS], mate_seat[NUM_PLAYERS];
+    for(int q = 0; q < NUM_PLAYERS; q++) {
+        seat[q] = _mm256_cmpeq_epi32(p, _mm256_set1_epi32(q));
+    }
+    for(int q = 0; q < NUM_PLAYERS; q++) {
+        mate_seat[q] = seat[TEAM_PLAY ? q ^ 1 : q];  // Only read in team mode
+    }
+    
+    // Three-sixes rule
+    __m256i sixes = batch_select(&b->sixes[0][0], BATCH_LANES, seat);
+    __m256i sixes_new = _mm256_and_si256(six, _mm256_add_epi32(sixes, one));
+    __m256i forfeit = _mm256_cmpeq_epi32(sixes_new, _mm256_set1_epi32(3));
+    sixes_new = _mm256_andnot_si256(forfeit, sixes_new);
+    
+    // Kills: a player's own, or either teammate's in team mode (teammates are seats 2k and 2k + 1)
+    __m256i hits = batch_select(&b->hits[0][0], BATCH_LANES, seat);
+    __m256i killed = _mm256_cmpgt_epi32(hits, zero);
+    __m256i mate = _mm256_xor_si256(p, one);
+    if(team_mode) {
+        __m256i mate_hits = batch_select(&b->hits[0][0], BATCH_LANES, mate_seat);
+        killed = _mm256_or_si256(killed, _mm256_cmpgt_epi32(mate_hits, zero));
+    }
+    
+    // The first movable token, as can_move_token sees it
+    __m256i start = _mm256_mullo_epi32(p, _mm256_set1_epi32(START_OFFSET(1)));
+    __m256i found = zero, token = zero, to_pos = zero, to_cell = zero, goes_home = zero, entered = zero;
+    
+    for(int t = 0; t < num_tokens; t++) {
+        __m256i pos = batch_select(&b->pos[t][0], MAX_TOKENS * BATCH_LANES, seat);
+        
+        __m256i enter = _mm256_and_si256(_mm256_cmpeq_epi32(pos, ones), six);
+        __m256i on_path = batch_between(pos, 0, PATH_LENGTH - 1);
+        __m256i new_pos = _mm256_add_epi32(pos, dice);
+        __m256i over = _mm256_cmpgt_epi32(new_pos, _mm256_set1_epi32(PATH_LENGTH - 1));
+        __m256i home_exact = _mm256_and_si256(_mm256_and_si256(over, killed), _mm256_cmpeq_epi32(new_pos, path_length));
+        __m256i loop = _mm256_andnot_si256(killed, over);
+        __m256i path = _mm256_and_si256(on_path, _mm256_or_si256(_mm256_xor_si256(over, ones), loop));
+        new_pos = _mm256_sub_epi32(new_pos, _mm256_and_si256(loop, path_length));
+        
+        __m256i target = _mm256_add_epi32(start, new_pos);
+        target = _mm256_sub_epi32(target, _mm256_and_si256(_mm256_cmpgt_epi32(target, _mm256_set1_epi32(PATH_LENGTH - 1)), path_length));
+        
+        __m256i blocked = _mm256_andnot_si256(killed, batch_cell_in(target, ring_gate_mask));
+        if(ring_safe_mask) {
+            __m256i occupied = zero;
+            for(int r = 0; r < BATCH_ROWS; r++) {
+                if(r % MAX_TOKENS < num_tokens) occupied = _mm256_or_si256(occupied, _mm256_cmpeq_epi32(LOADV(b->cell[r]), target));
+            }
+            blocked = _mm256_or_si256(blocked, _mm256_and_si256(occupied, batch_cell_in(target, ring_safe_mask)));
+        }
+        __m256i path_move = _mm256_andnot_si256(blocked, path);
+        __m256i movable = _mm256_or_si256(enter, _mm256_or_si256(home_exact, path_move));
+        
+        // move_token sends every overshooting team-mode token home
+        __m256i home = home_exact;
+        if(team_mode) home = _mm256_or_si256(home, _mm256_and_si256(path_move, over));
+        
+        __m256i take = _mm256_andnot_si256(found, movable);
+        found = _mm256_or_si256(found, take);
+        token = _mm256_blendv_epi8(token, _mm256_set1_epi32(t), take);
+        goes_home = _mm256_blendv_epi8(goes_home, home, take);
+        entered = _mm256_blendv_epi8(entered, enter, take);
+        __m256i final_pos = _mm256_blendv_epi8(_mm256_blendv_epi8(new_pos, path_length, home), zero, enter);
+        __m256i final_cell = _mm256_blendv_epi8(_mm256_blendv_epi8(target, ones, home), start, enter);
+        to_pos = _mm256_blendv_epi8(to_pos, final_pos, take);
+        to_cell = _mm256_blendv_epi8(to_cell, final_cell, take);
+    }
+    
+    __m256i rolled = _mm256_andnot_si256(forfeit, running);
+    __m256i moved = _mm256_and_si256(found, rolled);
+    __m256i no_move = _mm256_andnot_si256(found, rolled);
+    
+    // Captures as check_hits makes them: lowest opposing token on the landing cell,
+    // unless two or more opposing team tokens block it or the cell is safe
+    __m256i hit_check = _mm256_andnot_si256(_mm256_or_si256(goes_home, entered), moved);  // Entries never hit
+    __m256i victim_found = zero, victim = zero, opponents = zero;
+    for(int r = 0; r < BATCH_ROWS; r++) {
+        if(r % MAX_TOKENS >= num_tokens) continue;
+        __m256i owner = _mm256_set1_epi32(r / MAX_TOKENS);
+        __m256i friendly = _mm256_cmpeq_epi32(owner, p);
+        if(team_mode) friendly = _mm256_or_si256(friendly, _mm256_cmpeq_epi32(owner, mate));
+        __m256i match = _mm256_andnot_si256(friendly, _mm256_cmpeq_epi32(LOADV(b->cell[r]), to_cell));
+        victim = _mm256_blendv_epi8(victim, _mm256_set1_epi32(r), _mm256_andnot_si256(victim_found, match));
+        victim_found = _mm256_or_si256(victim_found, match);
+        opponents = _mm256_sub_epi32(opponents, match);
+    }
+    __m256i capture = _mm256_and_si256(hit_check, victim_found);
+    if(team_mode) capture = _mm256_and_si256(capture, _mm256_cmpgt_epi32(_mm256_set1_epi32(2), opponents));
+    if(ring_safe_mask) {
+        capture = _mm256_andnot_si256(batch_cell_in(to_cell, ring_safe_mask), capture);
+    }
+    
+    // Rolls that finish or eliminate the mover go to the scalar engine
+    __m256i home_count = batch_select(&b->home[0][0], BATCH_LANES, seat);
+    __m256i unable = batch_select(&b->unable[0][0], BATCH_LANES, seat);
+    __m256i finishing = _mm256_and_si256(_mm256_and_si256(moved, goes_home),
+                                         _mm256_cmpeq_epi32(_mm256_add_epi32(home_count, one), _mm256_set1_epi32(num_tokens)));
+    // unable is the count before this roll; the scalar engine tests >= STUCK_ROLLS after adding it
+    __m256i stuck = _mm256_and_si256(_mm256_and_si256(no_move, _mm256_cmpgt_epi32(unable, _mm256_set1_epi32(STUCK_ROLLS - 2))),
+                                     _mm256_cmpgt_epi32(_mm256_set1_epi32(3), LOADV(b->active_players)));
+    __m256i fallback = _mm256_or_si256(finishing, stuck);
+    __m256i fast = _mm256_andnot_si256(fallback, running);
+    moved = _mm256_and_si256(moved, fast);
+    no_move = _mm256_and_si256(no_move, fast);
+    capture = _mm256_and_si256(capture, fast);
+    
+    // Write back with whole-row blends, so no scatter is needed
+    __m256i unable_new = _mm256_blendv_epi8(_mm256_sub_epi32(unable, no_move), zero, moved);
+    for(int q = 0; q < NUM_PLAYERS; q++) {
+        __m256i mine = _mm256_and_si256(fast, seat[q]);
+        STOREV(b->sixes[q], _mm256_blendv_epi8(LOADV(b->sixes[q]), sixes_new, mine));
+        STOREV(b->unable[q], _mm256_blendv_epi8(LOADV(b->unable[q]), unable_new, mine));
+        STOREV(b->home[q], _mm256_sub_epi32(LOADV(b->home[q]), _mm256_and_si256(mine, _mm256_and_si256(moved, goes_home))));
+        STOREV(b->hits[q], _mm256_sub_epi32(LOADV(b->hits[q]), _mm256_and_si256(mine, capture)));
+    }
+    _Static_assert(MAX_TOKENS == 4, "the mover's row below is player << 2, one row per token");
+    __m256i mover_row = _mm256_add_epi32(_mm256_slli_epi32(p, 2), token);
+    for(int r = 0; r < BATCH_ROWS; r++) {
+        if(r % MAX_TOKENS >= num_tokens) continue;
+        __m256i row = _mm256_set1_epi32(r);
+        __m256i step = _mm256_and_si256(moved, _mm256_cmpeq_epi32(mover_row, row));
+        __m256i hit = _mm256_and_si256(capture, _mm256_cmpeq_epi32(victim, row));
+        __m256i pos = _mm256_blendv_epi8(LOADV(b->pos[r]), to_pos, step);
+        __m256i cell = _mm256_blendv_epi8(LOADV(b->cell[r]), to_cell, step);
+        STOREV(b->pos[r], _mm256_blendv_epi8(pos, ones, hit));
+        STOREV(b->cell[r], _mm256_blendv_epi8(cell, ones, hit));
+    }
+    
+    STOREV(b->again, _mm256_and_si256(_mm256_and_si256(moved, six), one));
+    STOREV(b->fallback, _mm256_and_si256(fallback, dice));
+}
+
+#undef LOADV
+#undef STOREV
+
+#else
+#define BATCH_HAVE_AVX2 0
+#endif
+
+// The batched kernel needs AVX2; elsewhere the scalar engine plays every game
+bool batch_kernel_available(void) {
+#if BATCH_HAVE_AVX2
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+// Outcome of one tournament game, kept for the per-game listing
+typedef struct {
+    int turns;
+    bool finished;
+    int rank[NUM_PLAYERS];
+    int hits[NUM_PLAYERS];
+} GameSummary;
+
+void print_summary(int game_number, GameSummary* summary) {
+    printf("Game %d: %d turns%s |", game_number, summary->turns,
+           summary->finished ? "" : " (unfinished)");
+    for(int i = 0; i < NUM_PLAYERS; i++) {
+        printf(" %s rank %d hits %d", arm_colors[SEAT_ARM(i)], summary->rank[i], summary->hits[i]);
+        printf(i < NUM_PLAYERS - 1 ? "," : "\n");
+    }
+}
+
+void summarize_game(Game* game, GameSummary* summary) {
+    summary->turns = game->turn_count;
+    summary->finished = game->active_players <= 1;
+    for(int i = 0; i < NUM_PLAYERS; i++) {
+        summary->rank[i] = game->players[i].rank;
+        summary->hits[i] = game->players[i].hit_record;
+    }
+}
+
+// Totals gathered by one worker and merged once all workers are done
+typedef struct {
+    long games;
+    long unfinished;
+    long turns;
+    long wins[NUM_PLAYERS];
+    long hits[NUM_PLAYERS];
+    SearchStats search;
+} TournamentStats;
+
+// Checkpoint file for hosted tables: a fixed header, then two fixed-layout records
+// per table in a shared mapping. After every turn a table writes the record its
+// last write did not use and publishes it by storing the sequence number last, so
+// a crash mid-write leaves the previous turn's record current. Resuming copies the
+// records straight back into the tables.
+#define CHECKPOINT_VERSION 1
+
+typedef struct {
+    char magic[4];       // "LUDK"
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t tables;
+    int32_t num_games;
+    int32_t num_tokens;
+    int32_t max_turns;
+    int32_t team_mode;
+    uint64_t seed;
+    int32_t rules;       // RULE_NO_* variants
+    uint8_t pad[20];
+} CheckpointHeader;
+
+typedef struct {
+    uint64_t seq;                  // Writes so far, 0 for never; the higher of a table's pair is current
+    uint64_t rng[4];
+    int32_t game_index;            // Game in progress, -1 once the table has no more games
+    int32_t next_game;
+    int32_t turn_count;
+    int8_t pos[NUM_PLAYERS][MAX_TOKENS];
+    int32_t hits[NUM_PLAYERS];
+    int32_t unable[NUM_PLAYERS];
+    uint8_t home[NUM_PLAYERS];
+    uint8_t sixes[NUM_PLAYERS];
+    uint8_t rank[NUM_PLAYERS];
+    uint8_t order[NUM_PLAYERS];
+    uint8_t active;                // Bit per active player
+    uint8_t active_players;
+    uint8_t current_rank;
+    uint8_t slot;
+    // Games the table has finished
+    int32_t games;
+    int32_t unfinished;
+    int64_t turns;
+    int64_t wins[NUM_PLAYERS];
+    int64_t total_hits[NUM_PLAYERS];
+} CheckpointRecord;
+
+typedef struct {
+    int fd;
+    size_t size;
+    CheckpointHeader* header;
+    CheckpointRecord* records;     // Pair per table
+    bool resumed;                  // Opened from an earlier run rather than created
+} Checkpoint;
+
+typedef struct {
+    int worker_id;
+    int num_workers;
+    int num_games;
+    int num_tokens;
+    bool team_mode;
+    int max_turns;
+    uint64_t seed;
+    GameSummary* summaries;  // Indexed by game number, NULL when quiet
+    Replay* replay;          // Log every game here (single worker only), NULL when not recording
+    EventLog* events;        // Event log with a stream per worker, NULL when not logging
+    const SearchConfig* search;  // AI seats, NULL for none
+    bool batched;                // Play on the AVX2 batched kernel
+    int tables;                  // Concurrent hosted tables, 0 to play games one after another
+    int table_first;             // Number of the worker's first table among all tables
+    int tables_total;
+    long turn_delay_ns;          // Pause between a hosted table's rolls
+    Checkpoint* checkpoint;      // Hosted table checkpoints, NULL for none
+    double resume_seconds;       // Time spent restoring the worker's tables
+    long resumed_games;          // Games its tables had finished before the checkpoint
+    TournamentStats stats;
+    pthread_t thread_id;
+} TournamentWorker;
+
+// Every game gets its own stream derived from the tournament seed and its index,
+// so results depend only on the seed, never on which worker played the game
+uint64_t game_seed(uint64_t seed, int game_index) {
+    return seed ^ (0xD1B54A32D192ED03ULL * (uint64_t)(game_index + 1));
+}
+
+void tally_game(TournamentWorker* worker, TournamentStats* stats, Game* game, int game_index) {
+    bool finished = game->active_players <= 1;
+    stats->games++;
+    stats->turns += game->turn_count;
+    if(!finished) stats->unfinished++;
+    
+    for(int i = 0; i < NUM_PLAYERS; i++) {
+        if(game->players[i].rank == 1) stats->wins[i]++;
+        stats->hits[i] += game->players[i].hit_record;
+    }
+    
+    if(worker->summaries) {
+        summarize_game(game, &worker->summaries[game_index]);
+    }
+}
+
+// The worker's games on the batched kernel: every lane that finishes a game takes the next one
+void tournament_batches(TournamentWorker* worker, Game* game, TournamentStats* stats) {
+#if BATCH_HAVE_AVX2
+    GameBatch batch;
+    Game scratch = *game;
+    int next = worker->worker_id;
+    int running = 0;
+    
+    memset(&batch, 0, sizeof(batch));
+    for(int lane = 0; lane < BATCH_LANES; lane++) {
+        batch.mover[lane] = -1;
+        batch.game_index[lane] = -1;
+    }
+    
+    for(;;) {
+        for(int lane = 0; lane < BATCH_LANES; lane++) {
+            if(batch.mover[lane] >= 0) continue;
+            if(batch.game_index[lane] >= 0) {
+                batch_store_lane(&batch, lane, game);
+                tally_game(worker, stats, game, batch.game_index[lane]);
+                batch.game_index[lane] = -1;
+                running--;
+            }
+            if(next < worker->num_games) {
+                batch_start_lane(&batch, lane, game, game_seed(worker->seed, next), next, worker->max_turns);
+                next += worker->num_workers;
+                running++;
+            }
+        }
+        if(running == 0) break;
+        
+        batch_step_avx2(&batch, worker->num_tokens, worker->team_mode);
+        batch_finish_step(&batch, &scratch, worker->max_turns);
+    }
+#else
+    (void)worker; (void)game; (void)stats;
+#endif
+}
+
+// Hosted tables: a worker multiplexes many concurrent games instead of giving
+// each one four player threads. Every table is a resumable turn state machine
+// advanced one roll at a time; between rolls it waits on the worker's run queue,
+// or, when there is a turn delay, parked on the worker's timer heap. A worker
+// owns its tables outright, so neither structure needs a lock.
+typedef struct {
+    Game game;
+    int order[NUM_PLAYERS];
+    int slot;         // Index into order of the player holding the turn
+    bool in_turn;     // The player has rolled a 6 and rolls again
+    int game_index;
+    int next_game;    // Tables deal games in strides of the table count
+    long wake_ns;     // Monotonic time the parked table resumes
+    TournamentStats tally;  // Games this table has finished
+} Table;
+
+typedef struct {
+    Table* tables;
+    int count;
+    int* ready;       // Ring of table indices ready to roll
+    int head, queued;
+    int* timers;      // Min-heap of parked table indices by wake_ns
+    int parked;
+} TableHost;
+
+static void host_ready(TableHost* host, int table) {
+    host->ready[(host->head + host->queued++) % host->count] = table;
+}
+
+static int host_next_ready(TableHost* host) {
+    int table = host->ready[host->head];
+    host->head = (host->head + 1) % host->count;
+    host->queued--;
+    return table;
+}
+
+static void host_park(TableHost* host, int table) {
+    int i = host->parked++;
+    long wake = host->tables[table].wake_ns;
+    while(i > 0 && host->tables[host->timers[(i - 1) / 2]].wake_ns > wake) {
+        host->timers[i] = host->timers[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    host->timers[i] = table;
+}
+
+static int host_unpark(TableHost* host) {
+    int top = host->timers[0];
+    int last = host->timers[--host->parked];
+    long wake = host->tables[last].wake_ns;
+    int i = 0;
+    
+    for(;;) {
+        int child = 2 * i + 1;
+        if(child >= host->parked) break;
+        if(child + 1 < host->parked && host->tables[host->timers[child + 1]].wake_ns < host->tables[host->timers[child]].wake_ns) child++;
+        if(host->tables[host->timers[child]].wake_ns >= wake) break;
+        host->timers[i] = host->timers[child];
+        i = child;
+    }
+    if(host->parked > 0) host->timers[i] = last;
+    return top;
+}
+
+// Hand the turn to the next active player the way play_game's loops do;
+// returns false once the game is over
+static bool table_next_player(Table* t, int max_turns) {
+    Game* game = &t->game;
+    
+    for(;;) {
+        if(game->active_players <= 1) return false;
+        if(++t->slot == NUM_PLAYERS) {
+            t->slot = 0;
+            if(game->turn_count >= max_turns) return false;
+        }
+        if(game->players[t->order[t->slot]].is_active) return true;
+    }
+}
+
+static bool table_start(Table* t, uint64_t seed, int game_index, int max_turns) {
+    reset_game(&t->game, seed);
+    deal_turn_order(&t->game, t->order);
+    t->slot = -1;
+    t->in_turn = false;
+    t->game_index = game_index;
+    if(t->game.active_players <= 1 || t->game.turn_count >= max_turns) return false;
+    return table_next_player(t, max_turns);
+}
+
+// The player holding the turn, whose turn starts with its first roll
+static Player* table_roller(Table* t) {
+    Player* player = &t->game.players[t->order[t->slot]];
+    
+    if(!t->in_turn) {
+        record_turn(&t->game, player->id);
+        t->in_turn = true;
+    }
+    return player;
+}
+
+// Move on after a roll: the same player rolls again, or the turn passes;
+// returns false once the game is over
+static bool table_after_roll(Table* t, bool again, int max_turns) {
+    if(again) return true;
+    
+    t->game.turn_count++;
+    t->in_turn = false;
+    return table_next_player(t, max_turns);
+}
+
+// Play one roll; returns false once the game is over
+static bool table_roll(Table* t, int max_turns) {
+    Player* player = table_roller(t);
+    return table_after_roll(t, play_roll(&t->game, player, roll_dice(&t->game)), max_turns);
+}
+
+// Seat the table's next game and queue it; games over before their first roll
+// are tallied on the spot. Returns whether a game was seated.
+static bool table_deal(TournamentWorker* worker, TableHost* host, int i) {
+    Table* t = &host->tables[i];
+    
+    while(t->next_game < worker->num_games) {
+        int g = t->next_game;
+        t->next_game += worker->tables_total;
+        if(table_start(t, game_seed(worker->seed, g), g, worker->max_turns)) {
+            host_ready(host, i);
+            return true;
+        }
+        tally_game(worker, &t->tally, &t->game, g);
+    }
+    t->game_index = -1;
+    return false;
+}
+
+int checkpoint_create(Checkpoint* cp, const char* path, int tables, int num_games, int num_tokens,
+                      bool team_mode, int max_turns, uint64_t seed) {
+    memset(cp, 0, sizeof(*cp));
+    cp->size = sizeof(CheckpointHeader) + 2 * (size_t)tables * sizeof(CheckpointRecord);
+    cp->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(cp->fd < 0 || ftruncate(cp->fd, cp->size) != 0) {
+        perror(path);
+        if(cp->fd >= 0) close(cp->fd);
+        return 1;
+    }
+    void* map = mmap(NULL, cp->size, PROT_READ | PROT_WRITE, MAP_SHARED, cp->fd, 0);
+    if(map == MAP_FAILED) {
+        perror(path);
+        close(cp->fd);
+        return 1;
+    }
+    
+    cp->header = map;
+    cp->records = (CheckpointRecord*)(cp->header + 1);
+    cp->header->version = CHECKPOINT_VERSION;
+    cp->header->record_size = sizeof(CheckpointRecord);
+    cp->header->tables = tables;
+    cp->header->num_games = num_games;
+    cp->header->num_tokens = num_tokens;
+    cp->header->max_turns = max_turns;
+    cp->header->team_mode = team_mode;
+    cp->header->rules = game_rules;
+    cp->header->seed = seed;
+    memcpy(cp->header->magic, "LUDK", 4);
+    return 0;
+}
+
+// Map an existing checkpoint; the caller takes the tournament settings from the header
+int checkpoint_open(Checkpoint* cp, const char* path) {
+    struct stat st;
+    
+    memset(cp, 0, sizeof(*cp));
+    cp->fd = open(path, O_RDWR);
+    if(cp->fd < 0 || fstat(cp->fd, &st) != 0) {
+        perror(path);
+        if(cp->fd >= 0) close(cp->fd);
+        return 1;
+    }
+    cp->size = st.st_size;
+    void* map = cp->size >= sizeof(CheckpointHeader) ?
+                mmap(NULL, cp->size, PROT_READ | PROT_WRITE, MAP_SHARED, cp->fd, 0) : MAP_FAILED;
+    cp->header = map;
+    if(map == MAP_FAILED || memcmp(cp->header->magic, "LUDK", 4) != 0 ||
+       cp->header->version != CHECKPOINT_VERSION || cp->header->record_size != sizeof(CheckpointRecord) ||
+       cp->size != sizeof(CheckpointHeader) + 2 * (size_t)cp->header->tables * sizeof(CheckpointRecord) ||
+       cp->header->num_tokens < 1 || cp->header->num_tokens > MAX_TOKENS) {
+        fprintf(stderr, "%s is not a checkpoint of this version\n", path);
+        if(map != MAP_FAILED) munmap(map, cp->size);
+        close(cp->fd);
+        return 1;
+    }
+    cp->records = (CheckpointRecord*)(cp->header + 1);
+    cp->resumed = true;
+    return 0;
+}
+
+void checkpoint_close(Checkpoint* cp) {
+    munmap(cp->header, cp->size);
+    close(cp->fd);
+}
+
+// Write a table into the older record of its pair
+static void checkpoint_save(CheckpointRecord* pair, const Table* t) {
+    uint64_t seq = (pair[0].seq > pair[1].seq ? pair[0].seq : pair[1].seq) + 1;
+    CheckpointRecord* r = &pair[seq & 1];
+    const Game* game = &t->game;
+    
+    memcpy(r->rng, game->rng.s, sizeof(r->rng));
+    r->game_index = t->game_index;
+    r->next_game = t->next_game;
+    r->turn_count = game->turn_count;
+    r->active = 0;
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        const Player* player = &game->players[p];
+        for(int k = 0; k < MAX_TOKENS; k++) {
+            r->pos[p][k] = (int8_t)player->token_positions[k];
+        }
+        r->hits[p] = player->hit_record;
+        r->unable[p] = player->consecutive_unable_to_move;
+        r->home[p] = (uint8_t)player->home_tokens;
+        r->sixes[p] = (uint8_t)player->consecutive_sixes;
+        r->rank[p] = (uint8_t)player->rank;
+        r->order[p] = (uint8_t)t->order[p];
+        if(player->is_active) r->active |= 1 << p;
+        r->wins[p] = t->tally.wins[p];
+        r->total_hits[p] = t->tally.hits[p];
+    }
+    r->active_players = (uint8_t)game->active_players;
+    r->current_rank = (uint8_t)game->current_rank;
+    r->slot = (uint8_t)t->slot;
+    r->games = (int32_t)t->tally.games;
+    r->unfinished = (int32_t)t->tally.unfinished;
+    r->turns = t->tally.turns;
+    
+    __atomic_store_n(&r->seq, seq, __ATOMIC_RELEASE);
+}
+
+// Restore a table from the current record of its pair; false if it was never written
+static bool checkpoint_load(const CheckpointRecord* pair, Table* t) {
+    const CheckpointRecord* r = &pair[pair[1].seq > pair[0].seq];
+    Game* game = &t->game;
+    
+    if(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) == 0) return false;
+    
+    reset_game(game, 0);
+    memcpy(game->rng.s, r->rng, sizeof(r->rng));
+    t->game_index = r->game_index;
+    t->next_game = r->next_game;
+    t->slot = r->slot;
+    t->in_turn = false;
+    game->turn_count = r->turn_count;
+    game->active_players = r->active_players;
+    game->current_rank = r->current_rank;
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        Player* player = &game->players[p];
+        for(int k = 0; k < player->num_tokens; k++) {
+            place_token(game, player, k, r->pos[p][k]);
+        }
+        player->hit_record = r->hits[p];
+        player->consecutive_unable_to_move = r->unable[p];
+        player->home_tokens = r->home[p];
+        player->consecutive_sixes = r->sixes[p];
+        player->rank = r->rank[p];
+        player->is_active = (r->active >> p) & 1;
+        t->order[p] = r->order[p];
+        t->tally.wins[p] = r->wins[p];
+        t->tally.hits[p] = r->total_hits[p];
+    }
+    t->tally.games = r->games;
+    t->tally.unfinished = r->unfinished;
+    t->tally.turns = r->turns;
+    return true;
+}
+
+// The worker's share of the tables; each table that finishes a game takes its next one
+void tournament_tables(TournamentWorker* worker, Game* game, TournamentStats* stats) {
+    TableHost host;
+    int live = 0;
+    long delay_ns = worker->turn_delay_ns;
+    CheckpointRecord* pairs = worker->checkpoint ? worker->checkpoint->records + 2 * worker->table_first : NULL;
+    
+    host.count = worker->tables;
+    host.tables = malloc(host.count * sizeof(Table));
+    host.ready = malloc(host.count * sizeof(int));
+    host.timers = malloc(host.count * sizeof(int));
+    host.head = host.queued = host.parked = 0;
+    if(!host.tables || !host.ready || !host.timers) {
+        fprintf(stderr, "Out of memory for %d tables\n", host.count);
+        free(host.tables);
+        free(host.ready);
+        free(host.timers);
+        return;
+    }
+    
+    double start = now_seconds();
+    for(int i = 0; i < host.count; i++) {
+        Table* t = &host.tables[i];
+        memset(&t->tally, 0, sizeof(t->tally));
+        t->game = *game;
+        t->game_index = -1;
+        t->next_game = worker->table_first + i;
+        
+        if(pairs && worker->checkpoint->resumed && checkpoint_load(&pairs[2 * i], t)) {
+            worker->resumed_games += t->tally.games;
+            if(t->game_index >= 0) {
+                host_ready(&host, i);
+                live++;
+            }
+            continue;
+        }
+        live += table_deal(worker, &host, i);
+        if(pairs) checkpoint_save(&pairs[2 * i], t);
+    }
+    worker->resume_seconds = now_seconds() - start;
+    
+    while(live > 0) {
+        if(host.parked > 0) {
+            long now = monotonic_ns();
+            while(host.parked > 0 && host.tables[host.timers[0]].wake_ns <= now) {
+                host_ready(&host, host_unpark(&host));
+            }
+            if(host.queued == 0) {
+                clock_sleep_until(host.tables[host.timers[0]].wake_ns);
+                continue;
+            }
+        }
+        
+        int i = host_next_ready(&host);
+        Table* t = &host.tables[i];
+        if(table_roll(t, worker->max_turns)) {
+            if(pairs && !t->in_turn) checkpoint_save(&pairs[2 * i], t);
+            if(delay_ns > 0) {
+                t->wake_ns = monotonic_ns() + delay_ns;
+                host_park(&host, i);
+            } else {
+                host_ready(&host, i);
+            }
+            continue;
+        }
+        
+        live--;
+        tally_game(worker, &t->tally, &t->game, t->game_index);
+        live += table_deal(worker, &host, i);
+        if(pairs) checkpoint_save(&pairs[2 * i], t);
+    }
+    
+    // Each table's game kept its own search totals across the games it hosted
+    for(int i = 0; i < host.count; i++) {
+        TournamentStats* tally = &host.tables[i].tally;
+        SearchStats* s = &host.tables[i].game.search_stats;
+        stats->games += tally->games;
+        stats->unfinished += tally->unfinished;
+        stats->turns += tally->turns;
+        for(int p = 0; p < NUM_PLAYERS; p++) {
+            stats->wins[p] += tally->wins[p];
+            stats->hits[p] += tally->hits[p];
+        }
+        stats->search.moves += s->moves;
+        stats->search.nodes += s->nodes;
+        stats->search.depth_sum += s->depth_sum;
+        stats->search.seconds += s->seconds;
+    }
+    
+    free(host.tables);
+    free(host.ready);
+    free(host.timers);
+}
+
+void* tournament_worker(void* arg) {
+    TournamentWorker* worker = (TournamentWorker*)arg;
+    TournamentStats stats;
+    SearchArena arena;
+    Game game;
+    
+    memset(&stats, 0, sizeof(stats));
+    memset(&arena, 0, sizeof(arena));
+    memset(&game, 0, sizeof(game));
+    game.num_tokens_per_player = worker->num_tokens;
+    if(worker->team_mode) setup_teams(&game);
+    game.replay = worker->replay;
+    game.events = worker->events ? &worker->events->streams[worker->worker_id] : NULL;
+    if(worker->search) {
+        game.search = worker->search;
+        game.choose_move = search_move;
+        game.arena = &arena;
+    }
+    
+    if(worker->tables) {
+        tournament_tables(worker, &game, &stats);
+        search_arena_release(&arena);
+        worker->stats = stats;
+        return NULL;
+    }
+    if(worker->batched) {
+        tournament_batches(worker, &game, &stats);
+        worker->stats = stats;
+        return NULL;
+    }
+    
+    for(int g = worker->worker_id; g < worker->num_games; g += worker->num_workers) {
+        reset_game(&game, game_seed(worker->seed, g));
+        if(game.replay) replay_begin_game(game.replay, &game, game_seed(worker->seed, g));
+        event_begin_game(&game, g, game_seed(worker->seed, g));
+        play_game(&game, worker->max_turns);
+        record_game_end(&game);
+        tally_game(worker, &stats, &game, g);
+    }
+    
+    search_arena_release(&arena);
+    stats.search = game.search_stats;
+    worker->stats = stats;
+    return NULL;
+}
+
+// Play num_games headless games spread over num_workers threads and report the merged results
+int run_tournament(int num_games, int num_workers, int num_tokens, bool team_mode,
+                   int max_turns, uint64_t seed, bool quiet, Replay* replay, EventLog* events,
+                   const SearchConfig* search, bool batched, int tables, Checkpoint* checkpoint) {
+    TournamentWorker* workers = calloc(num_workers, sizeof(TournamentWorker));
+    GameSummary* summaries = quiet ? NULL : calloc(num_games, sizeof(GameSummary));
+    
+    if(!workers || (!quiet && !summaries)) {
+        fprintf(stderr, "Out of memory for %d games\n", num_games);
+        free(workers);
+        free(summaries);
+        return 1;
+    }
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    for(int w = 0; w < num_workers; w++) {
+        workers[w].worker_id = w;
+        workers[w].num_workers = num_workers;
+        workers[w].num_games = num_games;
+        workers[w].num_tokens = num_tokens;
+        workers[w].team_mode = team_mode;
+        workers[w].max_turns = max_turns;
+        workers[w].seed = seed;
+        workers[w].summaries = summaries;
+        workers[w].replay = replay;
+        workers[w].events = events;
+        workers[w].search = search;
+        workers[w].batched = batched;
+        // Tables are dealt out as evenly as the workers allow
+        workers[w].tables = tables ? tables / num_workers + (w < tables % num_workers) : 0;
+        workers[w].table_first = w ? workers[w - 1].table_first + workers[w - 1].tables : 0;
+        workers[w].tables_total = tables;
+        workers[w].turn_delay_ns = clock_span(&game_clock, turn_delay_ticks);
+        workers[w].checkpoint = checkpoint;
+        pthread_create(&workers[w].thread_id, NULL, tournament_worker, &workers[w]);
+    }
+    
+    TournamentStats total;
+    double resume_seconds = 0;
+    long resumed_games = 0;
+    memset(&total, 0, sizeof(total));
+    
+    for(int w = 0; w < num_workers; w++) {
+        pthread_join(workers[w].thread_id, NULL);
+        if(workers[w].resume_seconds > resume_seconds) resume_seconds = workers[w].resume_seconds;
+        resumed_games += workers[w].resumed_games;
+        total.games += workers[w].stats.games;
+        total.unfinished += workers[w].stats.unfinished;
+        total.turns += workers[w].stats.turns;
+        for(int i = 0; i < NUM_PLAYERS; i++) {
+            total.wins[i] += workers[w].stats.wins[i];
+            total.hits[i] += workers[w].stats.hits[i];
+        }
+        total.search.moves += workers[w].stats.search.moves;
+        total.search.nodes += workers[w].stats.search.nodes;
+        total.search.depth_sum += workers[w].stats.search.depth_sum;
+        total.search.seconds += workers[w].stats.search.seconds;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    if(summaries) {
+        for(int g = 0; g < num_games; g++) {
+            print_summary(g + 1, &summaries[g]);
+        }
+    }
+    
+    char rules[64];
+    format_rules(game_rules, rules, sizeof(rules));
+    printf("\nSeed %llu, %d thread%s, %d token%s per player%s%s%s, %s\n",
+           (unsigned long long)seed, num_workers, num_workers == 1 ? "" : "s",
+           num_tokens, num_tokens == 1 ? "" : "s", team_mode ? ", team mode" : "",
+           game_rules ? ", rules " : "", game_rules ? rules : "",
+           tables ? "hosted tables" : batched ? "AVX2 batched kernel" : "scalar kernel");
+    if(tables) {
+        printf("%d concurrent tables, %zu bytes each, %.1f ms between rolls\n",
+               tables, sizeof(Table) + 2 * sizeof(int), clock_span(&game_clock, turn_delay_ticks) / 1e6);
+    }
+    if(checkpoint) {
+        printf("Checkpoint after every turn, %zu bytes per table", 2 * sizeof(CheckpointRecord));
+        if(checkpoint->resumed) printf("; resumed all tables in %.2f ms", 1e3 * resume_seconds);
+        printf("\n");
+    }
+    for(int i = 0; i < NUM_PLAYERS; i++) {
+        printf("  %-6s wins %5.1f%%  avg hits %.2f\n", arm_colors[SEAT_ARM(i)],
+               total.games ? 100.0 * total.wins[i] / total.games : 0.0,
+               total.games ? (double)total.hits[i] / total.games : 0.0);
+    }
+    printf("Average game length: %.1f turns\n", total.games ? (double)total.turns / total.games : 0.0);
+    if(search) print_search_stats(search, &total.search);
+    if(checkpoint && checkpoint->resumed) {
+        // Games finished before the checkpoint took none of this run's time
+        long played = total.games - resumed_games;
+        printf("\nPlayed %ld games (%ld unfinished after %d turns), %ld since the checkpoint in %.3f s: %.0f games/sec\n",
+               total.games, total.unfinished, max_turns, played, elapsed, elapsed > 0 ? played / elapsed : 0.0);
+    } else {
+        printf("\nPlayed %ld games (%ld unfinished after %d turns) in %.3f s: %.0f games/sec\n",
+               total.games, total.unfinished, max_turns, elapsed, elapsed > 0 ? total.games / elapsed : 0.0);
+    }
+    
+    free(workers);
+    free(summaries);
+    return 0;
+}
+
+// Re-execute every game in a replay log from its recorded rolls and turn order,
+// without rendering or delays, checking the engine makes exactly the recorded moves
+int run_replay(const char* path, bool quiet) {
+    FILE* in = fopen(path, "rb");
+    if(!in) {
+        perror(path);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    
+    uint8_t* data = malloc(size > 0 ? size : 1);
+    if(!data || fread(data, 1, size, in) != (size_t)size) {
+        fprintf(stderr, "Could not read %s\n", path);
+        fclose(in);
+        free(data);
+        return 1;
+    }
+    fclose(in);
+    
+    Replay replay;
+    Game game;
+    memset(&replay, 0, sizeof(replay));
+    memset(&game, 0, sizeof(game));
+    replay.data = data;
+    replay.len = size;
+    game.replay = &replay;
+    game.next_roll = replay_roll;
+    game.choose_move = replay_choose;
+    
+    long games = 0;
+    bool bad_header = false;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    while(replay.pos < replay.len && !replay.diverged) {
+        const uint8_t* header = data + replay.pos;
+        if(replay.len - replay.pos < REPLAY_HEADER_SIZE || memcmp(header, replay_magic, 4) != 0 ||
+           header[4] != 1 || header[5] < 1 || header[5] > MAX_TOKENS || header[6] >> 1 != NUM_ARMS - NUM_PLAYERS) {
+            bad_header = true;
+            break;
+        }
+        
+        uint64_t seed = 0;
+        for(int i = 0; i < 8; i++) {
+            seed |= (uint64_t)header[8 + i] << (8 * i);
+        }
+        game.num_tokens_per_player = header[5];
+        game.team_mode = false;
+        if(header[6] & 1) setup_teams(&game);
+        reset_game(&game, seed);
+        game.rules = header[7];
+        replay.pos += REPLAY_HEADER_SIZE;
+        
+        while(replay.pos < replay.len && !replay.diverged) {
+            int event = data[replay.pos];
+            if((event & 0xC0) == REPLAY_END) {
+                replay.pos++;
+                replay.events++;
+                break;
+            }
+            if((event & 0xC0) != REPLAY_TURN) {
+                replay_diverge(&replay);
+                break;
+            }
+            replay.pos++;
+            replay.events++;
+            
+            Player* player = &game.players[event & 0x03];
+            while(play_roll(&game, player, roll_dice(&game)) && !replay.diverged);
+            game.turn_count++;
+        }
+        
+        games++;
+        if(!quiet && !replay.diverged) {
+            GameSummary summary;
+            summarize_game(&game, &summary);
+            print_summary(games, &summary);
+        }
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    free(data);
+    
+    if(bad_header) {
+        fprintf(stderr, "%s: bad replay header at byte %zu\n", path, replay.pos);
+        return 1;
+    }
+    if(replay.diverged) {
+        fprintf(stderr, "Replay diverged from the log at byte %zu (game %ld, turn %d)\n",
+                replay.diverged_at, games, game.turn_count + 1);
+        return 1;
+    }
+    
+    printf("\nReplayed %ld games (%ld events, %zu bytes) in %.3f s: %.0f games/sec, %.0f events/sec\n",
+           games, replay.events, replay.len, elapsed,
+           elapsed > 0 ? games / elapsed : 0.0, elapsed > 0 ? replay.events / elapsed : 0.0);
+    return 0;
+}
+
+// Event log reader: count what the logged games did. Block headers are indexed
+// first, then the blocks are unpacked and scanned in parallel straight from the
+// mapped file; every event is self-delimiting, so blocks need no state from
+// the ones before them.
+typedef struct {
+    long counts[256];          // Events by first byte
+    long ended;
+    long turns;
+    long wins[NUM_PLAYERS];
+    long hits[NUM_PLAYERS];
+    long raw_bytes;
+} EventScan;
+
+typedef struct {
+    const uint8_t* data;
+    const size_t* blocks;      // Offsets of the block headers
+    long num_blocks;
+    int worker_id;
+    int num_workers;
+    bool corrupt;
+    EventScan scan;
+    pthread_t thread_id;
+} EventScanWorker;
+
+static const uint8_t event_size[16] = {
+    [EV_ROLL >> 4] = 1, [EV_TURN >> 4] = 1, [EV_MOVE >> 4] = 2, [EV_HIT >> 4] = 1,
+    [EV_HOME >> 4] = 1, [EV_LOOP >> 4] = 1, [EV_FORFEIT >> 4] = 1, [EV_PASS >> 4] = 1,
+    [EV_GAME >> 4] = 13, [EV_END >> 4] = 5 + 2 * NUM_PLAYERS,
+};
+
+// Counting by first byte keeps the loop free of branches on the event type,
+// which is close to random from one event to the next
+static bool scan_events(EventScan* scan, const uint8_t* at, const uint8_t* end) {
+    while(at < end) {
+        int size = event_size[*at >> 4];
+        if(!size || size > end - at) return false;
+        scan->counts[*at]++;
+        if(*at >= EV_END) {
+            scan->ended++;
+            scan->turns += at[1] | at[2] << 8 | at[3] << 16 | (uint32_t)at[4] << 24;
+            for(int i = 0; i < NUM_PLAYERS; i++) {
+                if(at[5 + i] == 1) scan->wins[i]++;
+                scan->hits[i] += at[5 + NUM_PLAYERS + i];
+            }
+        }
+        at += size;
+    }
+    return true;
+}
+
+// Events with the given tag, whatever their payload
+static long scan_count(const EventScan* scan, int tag) {
+    long n = 0;
+    for(int i = 0; i < 16; i++) n += scan->counts[tag | i];
+    return n;
+}
+
+static void* event_scan_worker(void* arg) {
+    EventScanWorker* worker = (EventScanWorker*)arg;
+    uint8_t* raw = malloc(EVENT_BLOCK_SIZE);
+    if(!raw) {
+        worker->corrupt = true;
+        return NULL;
+    }
+    
+    for(long b = worker->worker_id; b < worker->num_blocks && !worker->corrupt; b += worker->num_workers) {
+        EventBlockHeader header;
+        memcpy(&header, worker->data + worker->blocks[b], sizeof(header));
+        const uint8_t* payload = worker->data + worker->blocks[b] + sizeof(header);
+        const uint8_t* events = payload;
+        int len = (int)header.raw_len;
+        
+        if(header.packed_len < header.raw_len) {
+            if(lz_unpack(payload, (int)header.packed_len, raw, EVENT_BLOCK_SIZE) != len) {
+                worker->corrupt = true;
+                break;
+            }
+            events = raw;
+        }
+        if(!scan_events(&worker->scan, events, events + len)) worker->corrupt = true;
+        worker->scan.raw_bytes += len;
+    }
+    
+    free(raw);
+    return NULL;
+}
+
+int run_scan(const char* path, int num_workers) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if(fd >= 0) close(fd);
+        return 1;
+    }
+    size_t size = (size_t)st.st_size;
+    const uint8_t* data = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if(size && data == MAP_FAILED) {
+        perror(path);
+        return 1;
+    }
+    if(size) madvise((void*)data, size, MADV_SEQUENTIAL | MADV_WILLNEED);
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    // Index the blocks; a truncated last block (a run killed mid-write) is ignored
+    long num_blocks = 0;
+    long capacity = 1024;
+    size_t* blocks = malloc(capacity * sizeof(size_t));
+    size_t pos = 0;
+    bool bad_block = false;
+    while(blocks && pos + sizeof(EventBlockHeader) <= size) {
+        EventBlockHeader header;
+        memcpy(&header, data + pos, sizeof(header));
+        if(memcmp(header.magic, event_magic, 4) != 0 || header.raw_len > EVENT_BLOCK_SIZE ||
+           header.packed_len > header.raw_len) {
+            bad_block = true;
+            break;
+        }
+        if(pos + sizeof(header) + header.packed_len > size) break;
+        if(num_blocks == capacity) {
+            capacity *= 2;
+            size_t* grown = realloc(blocks, capacity * sizeof(size_t));
+            if(!grown) {
+                free(blocks);
+                blocks = NULL;
+                break;
+            }
+            blocks = grown;
+        }
+        blocks[num_blocks++] = pos;
+        pos += sizeof(header) + header.packed_len;
+    }
+    if(!blocks) {
+        fprintf(stderr, "Out of memory indexing %s\n", path);
+        if(size) munmap((void*)data, size);
+        return 1;
+    }
+    
+    if(num_workers < 1) num_workers = 1;
+    if(num_workers > num_blocks) num_workers = num_blocks ? (int)num_blocks : 1;
+    EventScanWorker* workers = calloc(num_workers, sizeof(EventScanWorker));
+    EventScan total;
+    bool corrupt = false;
+    memset(&total, 0, sizeof(total));
+    
+    for(int w = 0; workers && w < num_workers; w++) {
+        workers[w].data = data;
+        workers[w].blocks = blocks;
+        workers[w].num_blocks = num_blocks;
+        workers[w].worker_id = w;
+        workers[w].num_workers = num_workers;
+        pthread_create(&workers[w].thread_id, NULL, event_scan_worker, &workers[w]);
+    }
+    for(int w = 0; workers && w < num_workers; w++) {
+        pthread_join(workers[w].thread_id, NULL);
+        EventScan* scan = &workers[w].scan;
+        corrupt |= workers[w].corrupt;
+        total.ended += scan->ended;
+        total.turns += scan->turns;
+        for(int i = 0; i < 256; i++) total.counts[i] += scan->counts[i];
+        total.raw_bytes += scan->raw_bytes;
+        for(int i = 0; i < NUM_PLAYERS; i++) {
+            total.wins[i] += scan->wins[i];
+            total.hits[i] += scan->hits[i];
+        }
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    free(workers);
+    free(blocks);
+    if(size) munmap((void*)data, size);
+    
+    if(!workers) {
+        fprintf(stderr, "Out of memory for %d scan threads\n", num_workers);
+        return 1;
+    }
+    if(bad_block || corrupt) {
+        fprintf(stderr, "%s: corrupt event log%s\n", path, bad_block ? " block header" : " block");
+        return 1;
+    }
+    
+    long events = 0;
+    for(int i = 0; i < 256; i++) events += total.counts[i];
+    long rolls = scan_count(&total, EV_ROLL);
+    
+    printf("%ld games in %s (%ld with results)\n", scan_count(&total, EV_GAME), path, total.ended);
+    for(int i = 0; i < NUM_PLAYERS; i++) {
+        printf("  %-6s wins %5.1f%%  avg hits %.2f\n", arm_colors[SEAT_ARM(i)],
+               total.ended ? 100.0 * total.wins[i] / total.ended : 0.0,
+               total.ended ? (double)total.hits[i] / total.ended : 0.0);
+    }
+    printf("Average game length: %.1f turns\n", total.ended ? (double)total.turns / total.ended : 0.0);
+    printf("%ld rolls (%.1f%% sixes), %ld moves, %ld captures, %ld tokens home, %ld loops, %ld forfeits, %ld passes\n",
+           rolls, rolls ? 100.0 * total.counts[EV_ROLL | 6] / rolls : 0.0,
+           scan_count(&total, EV_MOVE), scan_count(&total, EV_HIT), scan_count(&total, EV_HOME),
+           scan_count(&total, EV_LOOP), scan_count(&total, EV_FORFEIT), scan_count(&total, EV_PASS));
+    printf("\nScanned %.1f MB (%.1f MB of events, %ld blocks) on %d thread%s in %.3f s: %.0f MB/s, %.0f events/sec\n",
+           pos / 1e6, total.raw_bytes / 1e6, num_blocks, num_workers, num_workers == 1 ? "" : "s", elapsed,
+           elapsed > 0 ? pos / 1e6 / elapsed : 0.0, elapsed > 0 ? events / elapsed : 0.0);
+    return 0;
+}
+
+// Markov analysis: the expected length of a game and the odds of each place in
+// the turn order, for a token count, team setting and set of rules. The chain
+// follows one player: the set of its token positions, whether it (or its team)
+// has a kill, and its run of sixes. Tokens are interchangeable in a set, so a roll
+// moves the most advanced token that can move; each single-token move is played
+// by play_token on an engine game. The other players enter as a mean field: their
+// occupancy and landings on every turn, taken from the chain itself, set the
+// chance that a move captures and that a token is captured before the next turn.
+// A round propagates the turn distribution until almost every player has finished
+// and hands its field to the next round, until the expected finish settles.
+#define MK_VALUES (PATH_LENGTH + 2)  // Token position + 1: yard, ring, home
+#define MK_MAX_TURNS 2500            // Turns one player is followed for (--max-turns over the seats)
+#define MK_TAIL 1e-7                 // Chance that a game is still on that ends a round
+#define MK_ROLL_FLOOR 1e-12          // Smaller masses stop rolling again after a six
+#define MK_MAX_ROUNDS 40
+#define MK_TOLERANCE 1e-4            // Relative change of the expected finish that ends the rounds
+#define MK_DAMPING 0.8               // Weight of a round's field against the previous one
+
+typedef struct {
+    int32_t next;    // Token set after the roll
+    int8_t landing;  // Ring position where the moved token may capture, -1 if none
+    uint8_t moved;
+} MarkovStep;
+
+// What the other players do to the chain on one turn
+typedef struct {
+    double hit[PATH_LENGTH];      // Chance that a move ending on the position captures
+    double capture[PATH_LENGTH];  // Chance that a token on the position is captured before the next turn
+    double partner_kill;          // Chance that a partner without a kill gets one before the next turn
+} MarkovField;
+
+// What the chain did on one turn
+typedef struct {
+    double alive;                   // Mass of unfinished players at the start of the turn
+    double unkilled;                // Part of it still without a kill
+    double finished;                // Mass finishing on the turn
+    double kills;                   // Mass getting its first kill on the turn
+    double captures;                // Tokens the player captures on the turn
+    double occupancy[PATH_LENGTH];  // Tokens on each ring position at the start of the turn
+    double landings[PATH_LENGTH];   // Moves ending on each ring position
+} MarkovTurn;
+
+typedef struct {
+    int num_tokens;
+    bool team_mode;
+    uint8_t rules;
+    int sixes;                    // Values of the three-sixes counter: 3, or 1 without the rule
+    int num_sets;
+    int8_t (*sets)[MAX_TOKENS];   // Token positions + 1, most advanced first
+    int32_t* set_index;           // Set of positions packed in base MK_VALUES
+    MarkovStep* steps;            // By set, kill flag and dice value
+    int32_t* captured;            // By set and subset of its tokens sent back to the yard
+    int home_set;
+    size_t num_states;            // (set * 2 + killed) * sixes + counter
+    MarkovField* field;           // By turn, from the previous round
+    MarkovTurn* turns;            // By turn, this round
+    int num_workers;
+    double** buffers[2];          // Mass pushed by each worker, alternating between passes
+} MarkovChain;
+
+typedef struct {
+    pthread_t thread_id;
+    MarkovChain* chain;
+    int id;
+    int turn;
+    int pass;  // 0 rolls, 1 captures
+    MarkovTurn stats;
+} MarkovWorker;
+
+// Index of a token set given in any order
+static int markov_lookup(const MarkovChain* chain, int8_t values[MAX_TOKENS]) {
+    int n = chain->num_tokens;
+    for(int i = 1; i < n; i++) {
+        int8_t v = values[i];
+        int j = i;
+        for(; j > 0 && values[j - 1] < v; j--) values[j] = values[j - 1];
+        values[j] = v;
+    }
+    int key = 0;
+    for(int i = n - 1; i >= 0; i--) key = key * MK_VALUES + values[i];
+    return chain->set_index[key];
+}
+
+// Every set of token values from max down, in decreasing order
+static void markov_add_sets(MarkovChain* chain, int8_t values[MAX_TOKENS], int depth, int max) {
+    if(depth == chain->num_tokens) {
+        int key = 0;
+        for(int i = depth - 1; i >= 0; i--) key = key * MK_VALUES + values[i];
+        memcpy(chain->sets[chain->num_sets], values, sizeof(chain->sets[0]));
+        chain->set_index[key] = chain->num_sets++;
+        return;
+    }
+    for(int v = max; v >= 0; v--) {
+        values[depth] = (int8_t)v;
+        markov_add_sets(chain, values, depth + 1, v);
+    }
+}
+
+// Enumerate the token sets and play every single-token move through the engine
+static int markov_build(MarkovChain* chain) {
+    int n = chain->num_tokens;
+    size_t keys = 1;
+    long num_sets = 1;
+    for(int i = 0; i < n; i++) {
+        keys *= MK_VALUES;
+        num_sets = num_sets * (MK_VALUES + i) / (i + 1);
+    }
+    chain->sets = calloc(num_sets, sizeof(*chain->sets));
+    chain->set_index = malloc(keys * sizeof(int32_t));
+    chain->steps = calloc((size_t)num_sets * 2 * 6, sizeof(MarkovStep));
+    chain->captured = calloc((size_t)num_sets << n, sizeof(int32_t));
+    if(!chain->sets || !chain->set_index || !chain->steps || !chain->captured) return 1;
+    
+    int8_t values[MAX_TOKENS] = {0};
+    chain->num_sets = 0;
+    markov_add_sets(chain, values, 0, MK_VALUES - 1);
+    for(int i = 0; i < n; i++) values[i] = MK_VALUES - 1;
+    chain->home_set = markov_lookup(chain, values);
+    chain->num_states = (size_t)chain->num_sets * 2 * chain->sixes;
+    
+    // One token alone on the board: where each roll takes it
+    MarkovStep moves[2][MK_VALUES][6];
+    Game base;
+    memset(&base, 0, sizeof(base));
+    base.num_tokens_per_player = 1;
+    if(chain->team_mode) setup_teams(&base);
+    reset_game(&base, 0);
+    base.rules = chain->rules;
+    for(int killed = 0; killed < 2; killed++) {
+        for(int v = 0; v < MK_VALUES; v++) {
+            for(int dice_value = 1; dice_value <= 6; dice_value++) {
+                Game game = base;
+                Player* player = &game.players[0];
+                MarkovStep* move = &moves[killed][v][dice_value - 1];
+                player->hit_record = killed;
+                if(v > 0) place_token(&game, player, 0, v - 1);
+                
+                int token_idx = first_movable_token(&game, player, dice_value);
+                move->moved = token_idx >= 0;
+                move->next = v;
+                move->landing = -1;
+                if(token_idx < 0) continue;
+                play_token(&game, player, dice_value, token_idx);
+                int to = player->token_positions[0];
+                move->next = to + 1;
+                if(v > 0 && to < PATH_LENGTH) move->landing = (int8_t)to;
+            }
+        }
+    }
+    
+    for(int s = 0; s < chain->num_sets; s++) {
+        for(int subset = 0; subset < 1 << n; subset++) {
+            memcpy(values, chain->sets[s], sizeof(values));
+            for(int i = 0; i < n; i++) {
+                if((subset >> i) & 1) values[i] = 0;
+            }
+            chain->captured[((size_t)s << n) + subset] = markov_lookup(chain, values);
+        }
+        for(int killed = 0; killed < 2; killed++) {
+            for(int dice_value = 1; dice_value <= 6; dice_value++) {
+                MarkovStep* step = &chain->steps[((size_t)s * 2 + killed) * 6 + dice_value - 1];
+                step->next = s;
+                step->landing = -1;
+                step->moved = 0;
+                for(int i = 0; i < n; i++) {
+                    const MarkovStep* move = &moves[killed][chain->sets[s][i]][dice_value - 1];
+                    if(!move->moved) continue;
+                    memcpy(values, chain->sets[s], sizeof(values));
+                    values[i] = (int8_t)move->next;
+                    step->next = markov_lookup(chain, values);
+                    step->landing = move->landing;
+                    step->moved = 1;
+                    break;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static inline void markov_push(const MarkovChain* chain, double* out, int set, int killed, int sixes, double mass) {
+    out[((size_t)set * 2 + killed) * chain->sixes + sixes] += mass;
+}
+
+// Play the rolls of one turn from a state, rolling again after every used six
+static void markov_roll(MarkovWorker* worker, double* out, const MarkovField* field,
+                        int set, int killed, int sixes, double mass) {
+    const MarkovChain* chain = worker->chain;
+    MarkovTurn* stats = &worker->stats;
+    
+    for(int dice_value = 1; dice_value <= 6; dice_value++) {
+        double p = mass / 6.0;
+        int next_sixes = 0;
+        if(dice_value == 6 && chain->sixes > 1) {
+            next_sixes = sixes + 1;
+            if(next_sixes == 3) {
+                markov_push(chain, out, set, killed, 0, p);  // Forfeited
+                continue;
+            }
+        }
+        const MarkovStep* step = &chain->steps[((size_t)set * 2 + killed) * 6 + dice_value - 1];
+        if(!step->moved) {
+            markov_push(chain, out, set, killed, next_sixes, p);
+            continue;
+        }
+        if(step->next == chain->home_set) {
+            stats->finished += p;
+            continue;
+        }
+        
+        double hit = 0.0;
+        if(step->landing >= 0) {
+            stats->landings[step->landing] += p;
+            if(!killed) hit = field->hit[step->landing];
+        }
+        if(step->landing >= 0) stats->captures += p * field->hit[step->landing];
+        stats->kills += p * hit;
+        bool again = dice_value == 6 && p > MK_ROLL_FLOOR;
+        for(int k = killed; k < 2; k++) {
+            double q = killed ? p : k ? p * hit : p * (1.0 - hit);
+            if(q == 0.0) continue;
+            if(again) markov_roll(worker, out, field, step->next, k, next_sixes, q);
+            else markov_push(chain, out, step->next, k, next_sixes, q);
+        }
+    }
+}
+
+// Captures and a partner's first kill between two turns of the player
+static void markov_capture(MarkovWorker* worker, double* out, const MarkovField* field,
+                           int set, int killed, int sixes, double mass) {
+    const MarkovChain* chain = worker->chain;
+    const int8_t* values = chain->sets[set];
+    int n = chain->num_tokens;
+    double risk[MAX_TOKENS];
+    int exposed = 0;
+    
+    for(int i = 0; i < n; i++) {
+        int pos = values[i] - 1;
+        risk[i] = 0.0;
+        if(pos < 0 || pos >= PATH_LENGTH) continue;
+        
+        // Two tokens of a team on one cell form a block
+        bool block = false;
+        for(int j = 0; j < n && chain->team_mode; j++) {
+            if(j != i && values[j] == values[i]) block = true;
+        }
+        if(!block && field->capture[pos] > 0.0) {
+            risk[i] = field->capture[pos];
+            exposed |= 1 << i;
+        }
+    }
+    
+    double kill = killed ? 0.0 : field->partner_kill;
+    for(int k = killed; k < 2; k++) {
+        double weight = killed ? mass : k ? mass * kill : mass * (1.0 - kill);
+        if(weight == 0.0) continue;
+        
+        // Every subset of the exposed tokens may be sent back to the yard
+        for(int captured = exposed; ; captured = (captured - 1) & exposed) {
+            double q = weight;
+            for(int i = 0; i < n; i++) {
+                if((exposed >> i) & 1) q *= (captured >> i) & 1 ? risk[i] : 1.0 - risk[i];
+            }
+            markov_push(chain, out, chain->captured[((size_t)set << n) + captured], k, sixes, q);
+            if(captured == 0) break;
+        }
+    }
+}
+
+// One pass over a slice of the states: gather the mass the workers pushed to them
+// in the previous pass, then push it on through this pass's transitions
+static void* markov_worker(void* arg) {
+    MarkovWorker* worker = arg;
+    MarkovChain* chain = worker->chain;
+    double** in = chain->buffers[worker->pass];
+    double* out = chain->buffers[1 - worker->pass][worker->id];
+    const MarkovField* field = &chain->field[worker->turn];
+    size_t begin = chain->num_states * worker->id / chain->num_workers;
+    size_t end = chain->num_states * (worker->id + 1) / chain->num_workers;
+    
+    memset(&worker->stats, 0, sizeof(worker->stats));
+    for(size_t s = begin; s < end; s++) {
+        double mass = 0.0;
+        for(int w = 0; w < chain->num_workers; w++) {
+            mass += in[w][s];
+            in[w][s] = 0.0;
+        }
+        if(mass == 0.0) continue;
+        
+        int sixes = (int)(s % chain->sixes);
+        int killed = (int)(s / chain->sixes) & 1;
+        int set = (int)(s / chain->sixes / 2);
+        if(worker->pass == 0) {
+            worker->stats.alive += mass;
+            if(!killed) worker->stats.unkilled += mass;
+            for(int i = 0; i < chain->num_tokens; i++) {
+                int pos = chain->sets[set][i] - 1;
+                if(pos >= 0 && pos < PATH_LENGTH) worker->stats.occupancy[pos] += mass;
+            }
+            markov_roll(worker, out, field, set, killed, sixes, mass);
+        } else {
+            markov_capture(worker, out, field, set, killed, sixes, mass);
+        }
+    }
+    return NULL;
+}
+
+// Propagate one player from the start until the game is almost surely over (a last
+// player without a kill may never finish); returns the turns followed
+static int markov_round(MarkovChain* chain, MarkovWorker* workers) {
+    int8_t yard[MAX_TOKENS] = {0};
+    markov_push(chain, chain->buffers[0][0], markov_lookup(chain, yard), 0, 0, 1.0);
+    
+    double done = 0.0;
+    int turn = 0;
+    for(; turn < MK_MAX_TURNS; turn++) {
+        MarkovTurn* total = &chain->turns[turn];
+        memset(total, 0, sizeof(*total));
+        for(int pass = 0; pass < 2; pass++) {
+            for(int w = 0; w < chain->num_workers; w++) {
+                workers[w].chain = chain;
+                workers[w].id = w;
+                workers[w].turn = turn;
+                workers[w].pass = pass;
+                pthread_create(&workers[w].thread_id, NULL, markov_worker, &workers[w]);
+            }
+            for(int w = 0; w < chain->num_workers; w++) {
+                pthread_join(workers[w].thread_id, NULL);
+                if(pass) continue;
+                MarkovTurn* stats = &workers[w].stats;
+                total->alive += stats->alive;
+                total->unkilled += stats->unkilled;
+                total->finished += stats->finished;
+                total->kills += stats->kills;
+                total->captures += stats->captures;
+                for(int p = 0; p < PATH_LENGTH; p++) {
+                    total->occupancy[p] += stats->occupancy[p];
+                    total->landings[p] += stats->landings[p];
+                }
+            }
+        }
+        // Games end with one player (or team) left
+        done += total->finished;
+        double on = chain->team_mode ? (1.0 - done * done) * (1.0 - done * done)
+                                     : 1.0 - pow(done, NUM_PLAYERS) - NUM_PLAYERS * pow(done, NUM_PLAYERS - 1) * (1.0 - done);
+        if(on < MK_TAIL || total->alive - total->finished < MK_TAIL) {
+            turn++;
+            break;
+        }
+    }
+    
+    // Drop what is left for the next round
+    for(int w = 0; w < chain->num_workers; w++) {
+        memset(chain->buffers[0][w], 0, chain->num_states * sizeof(double));
+    }
+    return turn;
+}
+
+// Turn the occupancy and landings of a round into the field of the next one
+static void markov_update_field(MarkovChain* chain, int turns, double damping) {
+    // How often each seat offset is an opponent: in team mode the partner sits
+    // next to the player, on one side or the other
+    double weight[NUM_PLAYERS];
+    for(int o = 0; o < NUM_PLAYERS; o++) weight[o] = o ? 1.0 : 0.0;
+    if(chain->team_mode) {
+        weight[1] = 0.5;
+        weight[NUM_PLAYERS - 1] = 0.5;
+    }
+    bool share = chain->team_mode && !(chain->rules & RULE_NO_TEAM_SHARE);
+    double done = 0.0;
+    
+    for(int t = 0; t < MK_MAX_TURNS; t++) {
+        const MarkovTurn* turn = &chain->turns[t < turns ? t : turns - 1];
+        MarkovField* field = &chain->field[t];
+        
+        // The player only plays while the game is on, so an opponent is still
+        // playing with the odds of being one of those the game waits for
+        double over = pow(done, chain->team_mode ? 2 : NUM_PLAYERS - 1);
+        double scale = over < 1.0 ? 1.0 / (1.0 - over) : 1.0;
+        if(t < turns) done += turn->finished;
+        for(int p = 0; p < PATH_LENGTH; p++) {
+            double occupied = 0.0, landed = 0.0;
+            for(int o = 1; o < NUM_PLAYERS; o++) {
+                int q = (p - START_OFFSET(o) + PATH_LENGTH) % PATH_LENGTH;
+                occupied += weight[o] * scale * turn->occupancy[q];
+                landed += weight[o] * scale * turn->landings[q];
+            }
+            // A lone opponent token is captured; in team mode two form a block
+            double hit = chain->team_mode ? occupied * exp(-occupied) : 1.0 - exp(-occupied);
+            field->hit[p] += damping * (hit - field->hit[p]);
+            field->capture[p] += damping * (1.0 - exp(-landed) - field->capture[p]);
+        }
+        double kill = share && turn->unkilled > 0.0 ? turn->kills / turn->unkilled : 0.0;
+        field->partner_kill += damping * (kill - field->partner_kill);
+    }
+}
+
+// Chance that the player in place seat of the turn order has finished by the
+// given turn slot of the game (NUM_PLAYERS slots to a round)
+static double markov_finished(const double* finished, int turns, int seat, long slot) {
+    if(slot < seat) return 0.0;
+    long t = (slot - seat) / NUM_PLAYERS + 1;
+    return finished[t < turns ? t : turns];
+}
+
+// Expected game length and the odds of the first place in the turn order, for
+// partner the place of its partner in team mode (0 without teams)
+static double markov_game(const double* finished, int turns, int partner, double odds[NUM_PLAYERS]) {
+    long slots = (long)(turns + 1) * NUM_PLAYERS;
+    double length = 0.0;
+    
+    for(int i = 0; i < NUM_PLAYERS; i++) odds[i] = 0.0;
+    for(long slot = 0; slot < slots; slot++) {
+        double done[NUM_PLAYERS], before[NUM_PLAYERS];
+        for(int i = 0; i < NUM_PLAYERS; i++) {
+            done[i] = markov_finished(finished, turns, i, slot);
+            before[i] = markov_finished(finished, turns, i, slot - 1);
+        }
+        int seat = (int)(slot % NUM_PLAYERS);
+        
+        if(!partner) {
+            // A player wins by finishing first; the game ends once one is left
+            double others = 1.0, waiting = 1.0;
+            for(int i = 0; i < NUM_PLAYERS; i++) {
+                if(i == seat) continue;
+                others *= before[i];
+                waiting *= 1.0 - done[i];
+            }
+            odds[seat] += (done[seat] - before[seat]) * waiting;
+            length += (1.0 - before[seat]) * (1.0 - others);
+        } else {
+            // A team wins once both partners are home, which ends the game
+            int team[NUM_PLAYERS];
+            for(int i = 0; i < NUM_PLAYERS; i++) team[i] = i == 0 || i == partner ? 0 : 1;
+            double complete[2] = {1.0, 1.0}, was[2] = {1.0, 1.0};
+            for(int i = 0; i < NUM_PLAYERS; i++) {
+                complete[team[i]] *= done[i];
+                was[team[i]] *= before[i];
+            }
+            odds[0] += (complete[0] - was[0]) * (1.0 - complete[1]);
+            length += (1.0 - before[seat]) * (1.0 - was[1 - team[seat]]);
+        }
+    }
+    return length;
+}
+
+int run_analysis(int num_tokens, bool team_mode, uint8_t rules, int num_workers) {
+    MarkovChain chain;
+    memset(&chain, 0, sizeof(chain));
+    chain.num_tokens = num_tokens;
+    chain.team_mode = team_mode;
+    chain.rules = rules;
+    chain.sixes = (rules & RULE_NO_THREE_SIXES) ? 1 : 3;
+    chain.num_workers = num_workers;
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    chain.field = calloc(MK_MAX_TURNS, sizeof(MarkovField));
+    chain.turns = calloc(MK_MAX_TURNS, sizeof(MarkovTurn));
+    MarkovWorker* workers = calloc(num_workers, sizeof(MarkovWorker));
+    double* finished = calloc(MK_MAX_TURNS + 1, sizeof(double));
+    bool ok = chain.field && chain.turns && workers && finished && markov_build(&chain) == 0;
+    for(int b = 0; b < 2 && ok; b++) {
+        chain.buffers[b] = calloc(num_workers, sizeof(double*));
+        for(int w = 0; chain.buffers[b] && w < num_workers; w++) {
+            chain.buffers[b][w] = calloc(chain.num_states, sizeof(double));
+            ok = ok && chain.buffers[b][w];
+        }
+        ok = ok && chain.buffers[b];
+    }
+    size_t bytes = (size_t)chain.num_sets * (sizeof(*chain.sets) + 12 * sizeof(MarkovStep) +
+                                             ((size_t)sizeof(int32_t) << num_tokens)) +
+                   (size_t)pow(MK_VALUES, num_tokens) * sizeof(int32_t) +
+                   2 * (size_t)num_workers * chain.num_states * sizeof(double);
+    
+    // Start every turn from a board with half the tokens out and one landing per turn
+    double expected = 0.0, previous = 0.0, captures = 0.0;
+    int rounds = 0, turns = 0;
+    if(ok) {
+        for(int t = 0; t < MK_MAX_TURNS; t++) {
+            MarkovTurn* turn = &chain.turns[t];
+            for(int p = 0; p < PATH_LENGTH; p++) {
+                turn->occupancy[p] = 0.5 * num_tokens / PATH_LENGTH;
+                turn->landings[p] = 1.0 / PATH_LENGTH;
+            }
+            turn->unkilled = 1.0;
+            turn->kills = 0.02;
+        }
+        markov_update_field(&chain, MK_MAX_TURNS, 1.0);
+        
+        do {
+            turns = markov_round(&chain, workers);
+            previous = expected;
+            expected = captures = 0.0;
+            for(int t = 0; t < turns; t++) {
+                expected += (t + 1) * chain.turns[t].finished;
+                captures += chain.turns[t].captures;
+                finished[t + 1] = finished[t] + chain.turns[t].finished;
+            }
+            expected /= finished[turns];
+            markov_update_field(&chain, turns, MK_DAMPING);
+            rounds++;
+        } while(rounds < MK_MAX_ROUNDS && fabs(expected - previous) > MK_TOLERANCE * expected);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    if(ok) {
+        char names[64];
+        format_rules(rules, names, sizeof(names));
+        printf("Markov analysis: %d token%s per player%s, %s rules\n", num_tokens,
+               num_tokens == 1 ? "" : "s", team_mode ? ", team mode" : "", names);
+        printf("Chain: %d token sets, %zu states per player, %.1f MB\n",
+               chain.num_sets, chain.num_states, bytes / 1e6);
+        printf("Mean field settled in %d rounds over %d turns\n", rounds, turns);
+        printf("\nExpected turns for a player to finish: %.1f (%.1f%% finish), capturing %.2f tokens\n",
+               expected, 100.0 * finished[turns], captures);
+        
+        double odds[NUM_PLAYERS];
+        if(!team_mode) {
+            double length = markov_game(finished, turns, 0, odds);
+            printf("Expected game length: %.1f turns\n", length);
+            printf("Win odds by place in the turn order:");
+            for(int i = 0; i < NUM_PLAYERS; i++) printf(" %.1f%%", 100.0 * odds[i]);
+            printf("\n");
+        } else {
+            // The deal puts the first player's partner in any other place alike
+            static const char* const place_names[NUM_ARMS] = {"1st", "2nd", "3rd", "4th"};
+            double length = 0.0, first = 0.0, by_partner[NUM_PLAYERS];
+            for(int partner = 1; partner < NUM_PLAYERS; partner++) {
+                length += markov_game(finished, turns, partner, odds) / (NUM_PLAYERS - 1);
+                by_partner[partner] = odds[0];
+                first += odds[0] / (NUM_PLAYERS - 1);
+            }
+            printf("Expected game length: %.1f turns\n", length);
+            printf("Win odds of the team playing first: %.1f%% (partner", 100.0 * first);
+            for(int partner = 1; partner < NUM_PLAYERS; partner++) {
+                printf("%s %s %.1f%%", partner > 1 ? "," : "", place_names[partner], 100.0 * by_partner[partner]);
+            }
+            printf(")\n");
+        }
+        printf("\nSolved on %d thread%s in %.2f s\n", num_workers, num_workers == 1 ? "" : "s", elapsed);
+    } else {
+        fprintf(stderr, "Out of memory for the Markov chain\n");
+    }
+    
+    for(int b = 0; b < 2; b++) {
+        for(int w = 0; chain.buffers[b] && w < num_workers; w++) free(chain.buffers[b][w]);
+        free(chain.buffers[b]);
+    }
+    free(chain.sets);
+    free(chain.set_index);
+    free(chain.steps);
+    free(chain.captured);
+    free(chain.field);
+    free(chain.turns);
+    free(workers);
+    free(finished);
+    return ok ? 0 : 1;
+}
+
+// Benchmarks: fixed-seed microbenchmarks of the rule and rendering hot paths over
+// a pool of mid-game positions, and full-game throughput per configuration.
+// Every entry reports its best of BENCH_REPEATS runs and a checksum of what it
+// computed, so runs on the same seed can be compared for speed and behavior.
+
+#define BENCH_POSITIONS 1024  // Mid-game positions the microbenchmarks cycle through
+#define BENCH_QUERIES 4096    // Power of two
+#define BENCH_REPEATS 3
+
+// One rule query: a token of a player in a pool position and a dice value
+typedef struct {
+    uint16_t game;
+    uint8_t player;
+    uint8_t token;
+    uint8_t dice;
+    uint8_t cell;  // Landing ring cell, for check_hits
+} BenchQuery;
+
+typedef struct {
+    Game* games;
+    BenchQuery queries[BENCH_QUERIES];  // Any active token, legal or not
+    BenchQuery moves[BENCH_QUERIES];    // Legal moves along the ring that stay short of home
+    UndoStack undo;
+    Renderer renderer;
+    uint64_t seed;
+} BenchData;
+
+typedef struct {
+    const char* name;
+    const char* config;  // Tokens, mode and kernel of a macrobenchmark, "-" otherwise
+    const char* unit;    // What one op is
+    long ops;
+    double seconds;      // Best run
+    uint64_t checksum;
+} BenchResult;
+
+typedef uint64_t (*BenchFn)(BenchData* d, long ops);
+
+// Play rolls first-movable-token style from a fresh game to get a mid-game position
+static void bench_position(Game* game, uint64_t seed, bool team, int rolls) {
+    memset(game, 0, sizeof(*game));
+    game->num_tokens_per_player = MAX_TOKENS;
+    if(team) setup_teams(game);
+    reset_game(game, seed);
+    
+    int p = 0;
+    for(int r = 0; r < rolls && game->active_players > 1; r++) {
+        Player* player = &game->players[p];
+        if(!player->is_active || !play_roll(game, player, roll_dice(game))) p = (p + 1) % NUM_PLAYERS;
+    }
+}
+
+static int bench_setup(BenchData* d, uint64_t seed) {
+    d->games = calloc(BENCH_POSITIONS, sizeof(Game));
+    if(!d->games) return 1;
+    d->seed = seed;
+    
+    uint64_t x = seed;
+    for(int i = 0; i < BENCH_POSITIONS; i++) {
+        uint64_t r = splitmix64(&x);
+        bench_position(&d->games[i], r, i & 1, (int)(r >> 40) % 400);
+    }
+    
+    Rng rng;
+    rng_seed(&rng, seed);
+    for(int n = 0, m = 0; n < BENCH_QUERIES || m < BENCH_QUERIES; ) {
+        BenchQuery q;
+        q.game = (uint16_t)rng_below(&rng, BENCH_POSITIONS);
+        q.player = (uint8_t)rng_below(&rng, NUM_PLAYERS);
+        q.token = (uint8_t)rng_below(&rng, MAX_TOKENS);
+        q.dice = (uint8_t)(rng_below(&rng, 6) + 1);
+        
+        Game* game = &d->games[q.game];
+        Player* player = &game->players[q.player];
+        int pos = player->token_positions[q.token];
+        q.cell = (uint8_t)ring_cell(q.player, (pos + q.dice) % PATH_LENGTH);
+        
+        if(!player->is_active) continue;
+        if(n < BENCH_QUERIES) d->queries[n++] = q;
+        if(m < BENCH_QUERIES && pos >= 0 && pos + q.dice < PATH_LENGTH &&
+           can_move_token(game, player, q.token, q.dice)) {
+            d->moves[m++] = q;
+        }
+    }
+    
+    // Moves are taken back through the undo journal
+    for(int i = 0; i < BENCH_POSITIONS; i++) {
+        d->games[i].undo = &d->undo;
+    }
+    return 0;
+}
+
+static uint64_t bench_roll_dice(BenchData* d, long ops) {
+    Game* game = &d->games[0];
+    Rng saved = game->rng;
+    uint64_t sum = 0;
+    
+    for(long i = 0; i < ops; i++) {
+        sum += roll_dice(game);
+    }
+    game->rng = saved;
+    return sum;
+}
+
+static uint64_t bench_can_move_token(BenchData* d, long ops) {
+    uint64_t sum = 0;
+    
+    for(long i = 0; i < ops; i++) {
+        const BenchQuery* q = &d->queries[i & (BENCH_QUERIES - 1)];
+        const Game* game = &d->games[q->game];
+        sum += can_move_token(game, &game->players[q->player], q->token, q->dice);
+    }
+    return sum;
+}
+
+static uint64_t bench_is_safe_square(BenchData* d, long ops) {
+    uint64_t sum = 0;
+    
+    for(long i = 0; i < ops; i++) {
+        const BenchQuery* q = &d->queries[i & (BENCH_QUERIES - 1)];
+        sum += is_safe_square(&d->games[q->game], q->cell);
+    }
+    return sum;
+}
+
+// Includes putting the moved and captured tokens back
+static uint64_t bench_move_token(BenchData* d, long ops) {
+    uint64_t sum = 0;
+    
+    for(long i = 0; i < ops; i++) {
+        const BenchQuery* q = &d->moves[i & (BENCH_QUERIES - 1)];
+        Game* game = &d->games[q->game];
+        Player* player = &game->players[q->player];
+        int hits = player->hit_record;
+        
+        move_token(game, player, q->token, q->dice);
+        sum += game->position_hash;
+        undo_placements(game, 0);
+        player->hit_record = hits;
+    }
+    return sum;
+}
+
+static uint64_t bench_check_hits(BenchData* d, long ops) {
+    uint64_t sum = 0;
+    
+    for(long i = 0; i < ops; i++) {
+        const BenchQuery* q = &d->moves[i & (BENCH_QUERIES - 1)];
+        Game* game = &d->games[q->game];
+        Player* player = &game->players[q->player];
+        int hits = player->hit_record;
+        
+        check_hits(game, player, q->cell);
+        sum += player->hit_record - hits;
+        undo_placements(game, 0);
+        player->hit_record = hits;
+    }
+    return sum;
+}
+
+// Frames against the previous position, as the interactive game draws them
+static uint64_t bench_render_frame(BenchData* d, long ops) {
+    Renderer* r = &d->renderer;
+    uint64_t sum = 0;
+    
+    r->on_screen = false;
+    for(long i = 0; i < ops; i++) {
+        render_frame(r, &d->games[i & (BENCH_POSITIONS - 1)]);
+        sum += r->len;
+    }
+    return sum;
+}
+
+// Whole-board repaints, as for the first frame
+static uint64_t bench_render_full(BenchData* d, long ops) {
+    Renderer* r = &d->renderer;
+    uint64_t sum = 0;
+    
+    for(long i = 0; i < ops; i++) {
+        r->on_screen = false;
+        render_frame(r, &d->games[i & (BENCH_POSITIONS - 1)]);
+        sum += r->len;
+    }
+    return sum;
+}
+
+static void bench_run(BenchResult* result, const char* name, const char* unit, BenchFn fn, BenchData* d, long ops) {
+    result->name = name;
+    result->config = "-";
+    result->unit = unit;
+    result->ops = ops;
+    result->seconds = 0;
+    
+    for(int rep = 0; rep < BENCH_REPEATS; rep++) {
+        double start = now_seconds();
+        result->checksum = fn(d, ops);
+        double elapsed = now_seconds() - start;
+        if(rep == 0 || elapsed < result->seconds) result->seconds = elapsed;
+    }
+}
+
+// Games played back to back on one thread; the checksum folds in every game's turns and winner
+static void bench_games(BenchResult* result, const char* config, int num_tokens, bool team_mode,
+                        bool batched, int num_games, uint64_t seed) {
+    result->name = "play_game";
+    result->config = config;
+    result->unit = "game";
+    result->ops = num_games;
+    result->seconds = 0;
+    
+    for(int rep = 0; rep < BENCH_REPEATS; rep++) {
+        TournamentWorker worker;
+        memset(&worker, 0, sizeof(worker));
+        worker.num_workers = 1;
+        worker.num_games = num_games;
+        worker.num_tokens = num_tokens;
+        worker.team_mode = team_mode;
+        worker.max_turns = 10000;
+        worker.seed = seed;
+        worker.batched = batched;
+        
+        double start = now_seconds();
+        tournament_worker(&worker);
+        double elapsed = now_seconds() - start;
+        if(rep == 0 || elapsed < result->seconds) result->seconds = elapsed;
+        
+        result->checksum = (uint64_t)worker.stats.turns;
+        for(int i = 0; i < NUM_PLAYERS; i++) {
+            result->checksum = result->checksum * 31 + (uint64_t)worker.stats.wins[i];
+        }
+    }
+}
+
+#define BENCH_TEXT 0
+#define BENCH_JSON 1
+#define BENCH_CSV  2
+
+static void print_bench(FILE* out, int format, BenchResult* results, int count, uint64_t seed) {
+    if(format == BENCH_JSON) {
+        fprintf(out, "{\n  \"seed\": %llu,\n  \"repeats\": %d,\n  \"avx2\": %s,\n  \"results\": [\n",
+                (unsigned long long)seed, BENCH_REPEATS, batch_kernel_available() ? "true" : "false");
+        for(int i = 0; i < count; i++) {
+            BenchResult* r = &results[i];
+            fprintf(out, "    {\"name\": \"%s\", \"config\": \"%s\", \"unit\": \"%s\", \"ops\": %ld, "
+                    "\"seconds\": %.6f, \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f, \"checksum\": \"%016llx\"}%s\n",
+                    r->name, r->config, r->unit, r->ops, r->seconds, 1e9 * r->seconds / r->ops,
+                    r->seconds > 0 ? r->ops / r->seconds : 0.0, (unsigned long long)r->checksum,
+                    i + 1 < count ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    } else if(format == BENCH_CSV) {
+        fprintf(out, "name,config,unit,ops,seconds,ns_per_op,ops_per_sec,checksum\n");
+        for(int i = 0; i < count; i++) {
+            BenchResult* r = &results[i];
+            fprintf(out, "%s,%s,%s,%ld,%.6f,%.2f,%.0f,%016llx\n",
+                    r->name, r->config, r->unit, r->ops, r->seconds, 1e9 * r->seconds / r->ops,
+                    r->seconds > 0 ? r->ops / r->seconds : 0.0, (unsigned long long)r->checksum);
+        }
+    } else {
+        fprintf(out, "Seed %llu, best of %d runs\n\n", (unsigned long long)seed, BENCH_REPEATS);
+        fprintf(out, "%-16s %-22s %12s %12s %14s  %s\n", "Benchmark", "Config", "Ops", "ns/op", "ops/sec", "Checksum");
+        for(int i = 0; i < count; i++) {
+            BenchResult* r = &results[i];
+            fprintf(out, "%-16s %-22s %12ld %12.1f %14.0f  %016llx\n",
+                    r->name, r->config, r->ops, 1e9 * r->seconds / r->ops,
+                    r->seconds > 0 ? r->ops / r->seconds : 0.0, (unsigned long long)r->checksum);
+        }
+    }
+}
+
+// Run every benchmark; ops scales the microbenchmarks and num_games the full games
+int run_bench(long ops, int num_games, uint64_t seed, int format, const char* out_path) {
+    static const struct {
+        const char* config;
+        int tokens;
+        bool team;
+    } configs[] = {
+        {"1 token", 1, false}, {"2 tokens", 2, false}, {"4 tokens", 4, false},
+        {"1 token team", 1, true}, {"2 tokens team", 2, true}, {"4 tokens team", 4, true},
+    };
+    int num_configs = sizeof(configs) / sizeof(configs[0]);
+    BenchResult results[8 + 2 * sizeof(configs) / sizeof(configs[0])];
+    char names[2 * sizeof(configs) / sizeof(configs[0])][32];
+    int count = 0;
+    
+    BenchData* d = calloc(1, sizeof(BenchData));
+    if(!d || bench_setup(d, seed) != 0) {
+        fprintf(stderr, "Out of memory for the benchmark positions\n");
+        if(d) free(d->games);
+        free(d);
+        return 1;
+    }
+    
+    bench_run(&results[count++], "roll_dice", "call", bench_roll_dice, d, ops);
+    bench_run(&results[count++], "can_move_token", "call", bench_can_move_token, d, ops);
+    bench_run(&results[count++], "is_safe_square", "call", bench_is_safe_square, d, ops);
+    bench_run(&results[count++], "move_token", "call", bench_move_token, d, ops);
+    bench_run(&results[count++], "check_hits", "call", bench_check_hits, d, ops);
+    bench_run(&results[count++], "render_frame", "frame", bench_render_frame, d, ops / 64);
+    bench_run(&results[count++], "render_full", "frame", bench_render_full, d, ops / 256);
+    
+    for(int c = 0; c < num_configs; c++) {
+        if(configs[c].team && !TEAM_PLAY) continue;
+        for(int k = 0; k < 2; k++) {
+            bool batched = k == 1;
+            if(batched && !batch_kernel_available()) continue;
+            snprintf(names[2 * c + k], sizeof(names[0]), "%s %s", configs[c].config, batched ? "simd" : "scalar");
+            bench_games(&results[count++], names[2 * c + k], configs[c].tokens, configs[c].team,
+                        batched, num_games, seed);
+        }
+    }
+    
+    FILE* out = stdout;
+    if(out_path) {
+        out = fopen(out_path, "w");
+        if(!out) {
+            perror(out_path);
+            free(d->games);
+            free(d);
+            return 1;
+        }
+    }
+    print_bench(out, format, results, count, seed);
+    if(out != stdout) fclose(out);
+    
+    free(d->games);
+    free(d);
+    return 0;
+}
+
+// Game server: the engine behind a Unix domain socket, driven by one epoll loop.
+// The protocol is one short text line per message:
+//   client  JOIN tokens team humans | ROLL | MOVE token
+//   server  SEAT table seat | START order... | TURN seat | ROLL seat dice |
+//           MOVES token... | STATE turns positions... | OVER turns ranks... | ERR text
+// A table starts once `humans` connections asking for the same settings have joined,
+// taking seats in join order. The remaining seats, and the seats of connections
+// that drop, are played by the built-in bot. MOVES is only sent when there is a
+// choice to make; a single legal move is played for the seat.
+
+#define SERVER_LINE_MAX 64
+#define SERVER_EVENTS 256
+
+typedef struct {
+    int fd;
+    char in[SERVER_LINE_MAX];
+    int in_len;
+    char* out;
+    int out_len, out_sent, out_cap;
+    bool dirty;    // Queued for the flush after this batch of events
+    bool writing;  // Waiting for EPOLLOUT
+    int table;     // -1 when not seated
+    int seat;
+} Connection;
+
+typedef struct {
+    Table t;
+    int conn[NUM_PLAYERS];  // fd of the seat's connection, -1 for the bot
+    int joined, humans;
+    bool started;
+    bool live;              // The game is still running
+    int pending_dice;       // Offered MOVES to the seat holding the turn for this roll, 0 if none
+} ServerTable;
+
+typedef struct {
+    int epfd;
+    int listen_fd;
+    Connection** conns;     // Indexed by fd
+    int conns_cap;
+    ServerTable* tables;
+    int num_tables, tables_cap;
+    int* free_tables;
+    int num_free;
+    int open_table[MAX_TOKENS + 1][2][NUM_PLAYERS + 1];  // Table waiting for players by settings, -1 for none
+    int* dirty;
+    int num_dirty;
+    uint64_t seed;
+    int max_turns;
+    long tables_started;    // Seeds the next table's game
+    long games, turns, requests, connections;
+} Server;
+
+static volatile sig_atomic_t server_stop;
+
+static void server_signal(int sig) {
+    (void)sig;
+    server_stop = 1;
+}
+
+// Allow as many sockets as the hard limit does
+static void raise_fd_limit(void) {
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static void conn_append(Server* s, Connection* c, const char* text, int len) {
+    if(c->out_len + len > c->out_cap) {
+        int cap = c->out_cap ? c->out_cap : 256;
+        while(cap < c->out_len + len) cap *= 2;
+        char* out = realloc(c->out, cap);
+        if(!out) return;
+        c->out = out;
+        c->out_cap = cap;
+    }
+    memcpy(c->out + c->out_len, text, len);
+    c->out_len += len;
+    if(!c->dirty) {
+        c->dirty = true;
+        s->dirty[s->num_dirty++] = c->fd;
+    }
+}
+
+static void conn_send(Server* s, Connection* c, const char* fmt, ...) {
+    char line[SERVER_LINE_MAX * 2];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    conn_append(s, c, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+}
+
+// Send one line to every connection seated at the table
+static void table_broadcast(Server* s, ServerTable* st, const char* fmt, ...) {
+    char line[SERVER_LINE_MAX * 2];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if(len >= (int)sizeof(line)) len = sizeof(line) - 1;
+
+    for(int seat = 0; seat < NUM_PLAYERS; seat++) {
+        if(st->conn[seat] >= 0) conn_append(s, s->conns[st->conn[seat]], line, len);
+    }
+}
+
+static void table_send_state(Server* s, ServerTable* st) {
+    Game* game = &st->t.game;
+    char line[SERVER_LINE_MAX * 2];
+    int len = snprintf(line, sizeof(line), "STATE %d", game->turn_count);
+
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        for(int t = 0; t < game->num_tokens_per_player; t++) {
+            len += snprintf(line + len, sizeof(line) - len, " %d", game->players[p].token_positions[t]);
+        }
+    }
+    table_broadcast(s, st, "%s\n", line);
+}
+
+static void server_end_game(Server* s, int ti) {
+    ServerTable* st = &s->tables[ti];
+    Game* game = &st->t.game;
+
+    char line[64];
+    int len = snprintf(line, sizeof(line), "OVER %d", game->turn_count);
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        len += snprintf(line + len, sizeof(line) - len, " %d", game->players[p].rank);
+    }
+    table_broadcast(s, st, "%s\n", line);
+    for(int seat = 0; seat < NUM_PLAYERS; seat++) {
+        if(st->conn[seat] >= 0) s->conns[st->conn[seat]]->table = -1;
+        st->conn[seat] = -1;
+    }
+    s->games++;
+    s->turns += game->turn_count;
+    s->free_tables[s->num_free++] = ti;
+}
+
+// Publish a finished roll and move the table on
+static void table_resolve(Server* s, ServerTable* st, bool again) {
+    st->pending_dice = 0;
+    table_send_state(s, st);
+    st->live = table_after_roll(&st->t, again, s->max_turns);
+}
+
+// Play bot seats until a connected player holds the turn or the game ends
+static void server_advance(Server* s, int ti) {
+    ServerTable* st = &s->tables[ti];
+
+    while(st->live) {
+        int seat = st->t.order[st->t.slot];
+        if(st->conn[seat] >= 0) {
+            table_broadcast(s, st, "TURN %d\n", seat);
+            return;
+        }
+        Player* player = table_roller(&st->t);
+        int dice_value = roll_dice(&st->t.game);
+        table_broadcast(s, st, "ROLL %d %d\n", seat, dice_value);
+        table_resolve(s, st, play_roll(&st->t.game, player, dice_value));
+    }
+    server_end_game(s, ti);
+}
+
+static void server_start_table(Server* s, int ti) {
+    ServerTable* st = &s->tables[ti];
+    char line[64];
+
+    st->started = true;
+    st->live = table_start(&st->t, game_seed(s->seed, (int)s->tables_started++), ti, s->max_turns);
+    int len = snprintf(line, sizeof(line), "START");
+    for(int p = 0; p < NUM_PLAYERS; p++) {
+        len += snprintf(line + len, sizeof(line) - len, " %d", st->t.order[p]);
+    }
+    table_broadcast(s, st, "%s\n", line);
+    server_advance(s, ti);
+}
+
+static void server_join(Server* s, Connection* c, int tokens, int team, int humans) {
+    if(c->table >= 0 || tokens < 1 || tokens > MAX_TOKENS || team < 0 || team > TEAM_PLAY ||
+       humans < 1 || humans > NUM_PLAYERS) {
+        conn_send(s, c, "ERR join\n");
+        return;
+    }
+
+    int ti = s->open_table[tokens][team][humans];
+    if(ti < 0) {
+        if(s->num_free > 0) {
+            ti = s->free_tables[--s->num_free];
+        } else {
+            if(s->num_tables == s->tables_cap) {
+                int cap = s->tables_cap ? 2 * s->tables_cap : 64;
+                ServerTable* tables = realloc(s->tables, cap * sizeof(ServerTable));
+                int* free_tables = realloc(s->free_tables, cap * sizeof(int));
+                if(free_tables) s->free_tables = free_tables;
+                if(!tables || !free_tables) {
+                    if(tables) s->tables = tables;
+                    conn_send(s, c, "ERR full\n");
+                    return;
+                }
+                s->tables = tables;
+                s->tables_cap = cap;
             }
+            ti = s->num_tables++;
+        }
+        ServerTable* st = &s->tables[ti];
+        memset(st, 0, sizeof(*st));
+        st->t.game.num_tokens_per_player = tokens;
+        if(team) setup_teams(&st->t.game);
+        st->humans = humans;
+        for(int seat = 0; seat < NUM_PLAYERS; seat++) {
+            st->conn[seat] = -1;
         }
+        s->open_table[tokens][team][humans] = ti;
+    }
+
+    ServerTable* st = &s->tables[ti];
+    c->table = ti;
+    c->seat = st->joined++;
+    st->conn[c->seat] = c->fd;
+    conn_send(s, c, "SEAT %d %d\n", ti, c->seat);
+
+    if(st->joined == st->humans) {
+        s->open_table[tokens][team][humans] = -1;
+        server_start_table(s, ti);
     }
-    return false;
 }
 
+static void server_roll(Server* s, Connection* c) {
+    ServerTable* st = c->table >= 0 ? &s->tables[c->table] : NULL;
+    if(!st || !st->started || !st->live || st->t.order[st->t.slot] != c->seat || st->pending_dice) {
+        conn_send(s, c, "ERR roll\n");
+        return;
+    }
 
-// Modify player_turn function to handle game termination
-void* player_turn(void* arg) {
-    Player* player = (Player*)arg;
-    int consecutive_unable_to_move = 0;
-    int consecutive_sixes = 0;  // Track number of consecutive 6s
-    bool teammate_finished = false;
-    int teammate_id = -1;
+    Game* game = &st->t.game;
+    Player* player = table_roller(&st->t);
+    int dice_value = roll_dice(game);
+    table_broadcast(s, st, "ROLL %d %d\n", c->seat, dice_value);
 
-    if(team_mode) {
-        for(int i = 0; i < 2; i++) {
-            if(teams[i].player1_id == player->id) {
-                teammate_id = teams[i].player2_id;
-                break;
-            } else if(teams[i].player2_id == player->id) {
-                teammate_id = teams[i].player1_id;
-                break;
+    if(forfeits_turn(game, player, dice_value)) {
+        table_resolve(s, st, false);
+    } else {
+        int tokens[MAX_TOKENS];
+        int count = movable_tokens(game, player, dice_value, tokens);
+        if(count >= 2) {
+            char line[SERVER_LINE_MAX];
+            int len = snprintf(line, sizeof(line), "MOVES");
+            for(int i = 0; i < count; i++) {
+                len += snprintf(line + len, sizeof(line) - len, " %d", tokens[i]);
             }
+            conn_send(s, c, "%s\n", line);
+            st->pending_dice = dice_value;
+            return;
         }
+        table_resolve(s, st, play_token(game, player, dice_value, count ? tokens[0] : -1));
     }
-    
-    while(player->is_active && active_players > 1) {
-        sem_wait(&dice_semaphore);
-        
-        pthread_mutex_lock(&turn_mutex);
-        while(previous_turn == player->id) {
-            pthread_cond_wait(&turn_cond, &turn_mutex);
+    server_advance(s, c->table);
+}
+
+static void server_move(Server* s, Connection* c, int token_idx) {
+    ServerTable* st = c->table >= 0 ? &s->tables[c->table] : NULL;
+    if(!st || !st->pending_dice || st->t.order[st->t.slot] != c->seat) {
+        conn_send(s, c, "ERR move\n");
+        return;
+    }
+
+    Game* game = &st->t.game;
+    Player* player = &game->players[c->seat];
+    int tokens[MAX_TOKENS];
+    int count = movable_tokens(game, player, st->pending_dice, tokens);
+    bool legal = false;
+    for(int i = 0; i < count; i++) {
+        if(tokens[i] == token_idx) legal = true;
+    }
+    if(!legal) {
+        conn_send(s, c, "ERR move\n");
+        return;
+    }
+
+    table_resolve(s, st, play_token(game, player, st->pending_dice, token_idx));
+    server_advance(s, c->table);
+}
+
+static void server_line(Server* s, Connection* c, char* line) {
+    int a, b, n;
+
+    s->requests++;
+    if(strcmp(line, "ROLL") == 0) {
+        server_roll(s, c);
+    } else if(sscanf(line, "MOVE %d", &a) == 1) {
+        server_move(s, c, a);
+    } else if(sscanf(line, "JOIN %d %d %d", &a, &b, &n) == 3) {
+        server_join(s, c, a, b, n);
+    } else {
+        conn_send(s, c, "ERR unknown\n");
+    }
+}
+
+// Drop a connection; its seat goes to the bot, which plays on if it held the turn
+static void server_close(Server* s, Connection* c) {
+    epoll_ctl(s->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    s->conns[c->fd] = NULL;
+
+    if(c->table >= 0) {
+        ServerTable* st = &s->tables[c->table];
+        st->conn[c->seat] = -1;
+        if(st->started && st->live && st->t.order[st->t.slot] == c->seat) {
+            if(st->pending_dice) {
+                Game* game = &st->t.game;
+                Player* player = &game->players[c->seat];
+                int token_idx = first_movable_token(game, player, st->pending_dice);
+                table_resolve(s, st, play_token(game, player, st->pending_dice, token_idx));
+            }
+            server_advance(s, c->table);
         }
-        
-        bool continue_turn = true;
-        while(continue_turn && player->is_active) {
-            int dice_value = roll_dice();
-            printf("\nPlayer %s rolled: %d\n", player->color, dice_value);
-            
-            if(dice_value == 6) {
-                consecutive_sixes++;
-                if(consecutive_sixes == 3) {
-                    printf("Third consecutive 6! Turn forfeited for Player %s\n", player->color);
-                    consecutive_sixes = 0;
-                    continue_turn = false;
-                    sem_post(&dice_semaphore);
-                    sem_wait(&board_semaphore);
-                    display_board();
-                    sem_post(&board_semaphore);
-                    break;
-                }
-            } else {
-                consecutive_sixes = 0;
-                continue_turn = false;
+    }
+    free(c->out);
+    free(c);
+}
+
+static void server_accept(Server* s) {
+    for(;;) {
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if(fd < 0) return;
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+
+        if(fd >= s->conns_cap) {
+            int cap = s->conns_cap;
+            while(cap <= fd) cap *= 2;
+            Connection** conns = realloc(s->conns, cap * sizeof(Connection*));
+            int* dirty = realloc(s->dirty, cap * sizeof(int));
+            if(dirty) s->dirty = dirty;
+            if(!conns || !dirty) {
+                if(conns) s->conns = conns;
+                close(fd);
+                continue;
             }
-            
-            sem_post(&dice_semaphore);
-            sem_wait(&board_semaphore);
-            
-            bool moved = false;
-            
-            // Check if player can move their own pieces
-            for(int i = 0; i < player->num_tokens; i++) {
-                if(player->token_positions[i] == -1 && dice_value == 6) {
-                    player->token_positions[i] = 0;
-                    player->tokens[i][0] = path_coords[player->id][0][0];
-                    player->tokens[i][1] = path_coords[player->id][0][1];
-                    moved = true;
-                    printf("Player %s started a new token\n", player->color);
-                    consecutive_unable_to_move = 0;
-                    break;
-                } else if(player->token_positions[i] >= 0 && can_move_token(player, i, dice_value)) {
-                    move_token(player, i, dice_value);
-                    moved = true;
-                    printf("Player %s moved token %d\n", player->color, i + 1);
-                    consecutive_unable_to_move = 0;
-                    break;
-                }
+            memset(conns + s->conns_cap, 0, (cap - s->conns_cap) * sizeof(Connection*));
+            s->conns = conns;
+            s->conns_cap = cap;
+        }
+
+        Connection* c = calloc(1, sizeof(Connection));
+        if(!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->table = -1;
+        s->conns[fd] = c;
+        s->connections++;
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+        epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+static void server_read(Server* s, Connection* c) {
+    char buf[4096];
+
+    for(;;) {
+        ssize_t got = read(c->fd, buf, sizeof(buf));
+        if(got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR)) {
+            server_close(s, c);
+            return;
+        }
+        if(got < 0) return;
+
+        for(ssize_t i = 0; i < got; i++) {
+            if(buf[i] == '\n') {
+                c->in[c->in_len] = '\0';
+                server_line(s, c, c->in);
+                c->in_len = 0;
+            } else if(c->in_len < SERVER_LINE_MAX - 1) {
+                c->in[c->in_len++] = buf[i];
             }
-            
-            // If player has finished and rolled a 6, they can move teammate's pieces
-            if(team_mode && player->home_tokens == player->num_tokens && dice_value == 6) {
-                Player* teammate = NULL;
-                for(int i = 0; i < 2; i++) {
-                    if(teams[i].player1_id == player->id) {
-                        teammate = &players[teams[i].player2_id];
-                        break;
-                    } else if(teams[i].player2_id == player->id) {
-                        teammate = &players[teams[i].player1_id];
-                        break;
+        }
+    }
+}
+
+// Write out everything queued during this batch of events
+static void server_flush(Server* s) {
+    for(int i = 0; i < s->num_dirty; i++) {
+        int fd = s->dirty[i];
+        Connection* c = s->conns[fd];
+        if(!c || !c->dirty) continue;  // Closed, or already flushed
+        c->dirty = false;
+
+        while(c->out_sent < c->out_len) {
+            ssize_t sent = send(c->fd, c->out + c->out_sent, c->out_len - c->out_sent, MSG_NOSIGNAL);
+            if(sent <= 0) break;
+            c->out_sent += sent;
+        }
+
+        bool pending = c->out_sent < c->out_len;
+        if(!pending) c->out_len = c->out_sent = 0;
+        if(pending != c->writing) {
+            struct epoll_event ev = { .events = EPOLLIN | (pending ? EPOLLOUT : 0), .data.fd = c->fd };
+            epoll_ctl(s->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+            c->writing = pending;
+        }
+    }
+    s->num_dirty = 0;
+}
+
+int run_server(const char* path, uint64_t seed, int max_turns) {
+    Server* s = calloc(1, sizeof(Server));
+    struct sockaddr_un addr;
+
+    if(!s || strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Cannot serve on %s\n", path);
+        free(s);
+        return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    raise_fd_limit();
+    s->seed = seed;
+    s->max_turns = max_turns;
+    s->conns_cap = 1024;
+    s->conns = calloc(s->conns_cap, sizeof(Connection*));
+    s->dirty = calloc(s->conns_cap, sizeof(int));
+    memset(s->open_table, -1, sizeof(s->open_table));
+
+    s->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if(!s->conns || !s->dirty || s->listen_fd < 0 ||
+       bind(s->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(s->listen_fd, SOMAXCONN) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    s->epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = s->listen_fd };
+    epoll_ctl(s->epfd, EPOLL_CTL_ADD, s->listen_fd, &ev);
+
+    signal(SIGINT, server_signal);
+    signal(SIGTERM, server_signal);
+    printf("Serving on %s (seed %llu), Ctrl-C to stop\n", path, (unsigned long long)seed);
+    fflush(stdout);
+
+    struct epoll_event events[SERVER_EVENTS];
+    while(!server_stop) {
+        int n = epoll_wait(s->epfd, events, SERVER_EVENTS, -1);
+        for(int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if(fd == s->listen_fd) {
+                server_accept(s);
+                continue;
+            }
+            Connection* c = s->conns[fd];
+            if(!c) continue;
+            if(events[i].events & (EPOLLERR | EPOLLHUP)) {
+                server_close(s, c);
+                continue;
+            }
+            if((events[i].events & EPOLLOUT) && !c->dirty) {
+                c->dirty = true;
+                s->dirty[s->num_dirty++] = fd;
+            }
+            if(events[i].events & EPOLLIN) server_read(s, c);
+        }
+        server_flush(s);
+    }
+
+    printf("\nServed %ld connections, %ld requests, %ld games, %ld turns\n",
+           s->connections, s->requests, s->games, s->turns);
+
+    for(int fd = 0; fd < s->conns_cap; fd++) {
+        if(s->conns[fd]) {
+            close(fd);
+            free(s->conns[fd]->out);
+            free(s->conns[fd]);
+        }
+    }
+    close(s->listen_fd);
+    close(s->epfd);
+    unlink(path);
+    free(s->conns);
+    free(s->dirty);
+    free(s->tables);
+    free(s->free_tables);
+    free(s);
+    return 0;
+}
+
+// Load generator: many client connections on one epoll loop, each playing its
+// seat by taking the first move offered and joining again after every game.
+// Round trips are timed from a ROLL to the server's ROLL line for the seat, and
+// from a MOVE to the next STATE.
+
+typedef struct {
+    int fd;
+    char in[SERVER_LINE_MAX * 2];
+    int in_len;
+    int seat;
+    long sent_ns;  // Request in flight since, 0 for none
+} LoadConn;
+
+static int compare_long(const void* a, const void* b) {
+    long x = *(const long*)a, y = *(const long*)b;
+    return (x > y) - (x < y);
+}
+
+static void load_send(LoadConn* c, const char* line) {
+    send(c->fd, line, strlen(line), MSG_NOSIGNAL);
+}
+
+int run_load(const char* path, int clients, int num_games, int tokens, bool team, int humans) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    raise_fd_limit();
+    LoadConn* conns = calloc(clients, sizeof(LoadConn));
+    long samples_cap = 1 << 16, num_samples = 0;
+    long* samples = malloc(samples_cap * sizeof(long));
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    char join[SERVER_LINE_MAX];
+    snprintf(join, sizeof(join), "JOIN %d %d %d\n", tokens, team ? 1 : 0, humans);
+
+    if(!conns || !samples) {
+        fprintf(stderr, "Out of memory for %d clients\n", clients);
+        return 1;
+    }
+
+    double start = now_seconds();
+    for(int i = 0; i < clients; i++) {
+        LoadConn* c = &conns[i];
+        c->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(c->fd < 0 || connect(c->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            perror(path);
+            return 1;
+        }
+        fcntl(c->fd, F_SETFL, O_NONBLOCK);
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)i };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+        c->seat = -1;
+        load_send(c, join);
+    }
+
+    long games = 0, turns = 0, requests = 0, errors = 0;
+    bool lost = false;
+    struct epoll_event events[SERVER_EVENTS];
+    while(games < num_games && !lost) {
+        int n = epoll_wait(epfd, events, SERVER_EVENTS, 5000);
+        if(n == 0) {
+            fprintf(stderr, "No reply from the server for 5 s\n");
+            lost = true;
+        }
+        for(int e = 0; e < n && games < num_games && !lost; e++) {
+            LoadConn* c = &conns[events[e].data.u32];
+            char buf[8192];
+            ssize_t got;
+
+            while((got = read(c->fd, buf, sizeof(buf))) > 0) {
+                for(ssize_t i = 0; i < got; i++) {
+                    if(buf[i] != '\n') {
+                        if(c->in_len < (int)sizeof(c->in) - 1) c->in[c->in_len++] = buf[i];
+                        continue;
                     }
-                }
-                
-                if(teammate && !teammate->is_active) {
-                    dice_value = roll_dice();  // Roll again for teammate
-                    printf("\nPlayer %s rolling for teammate %s: %d\n", 
-                           player->color, teammate->color, dice_value);
-                    
-                    for(int i = 0; i < teammate->num_tokens; i++) {
-                        if(can_move_token(teammate, i, dice_value)) {
-                            move_token(teammate, i, dice_value);
-                            moved = true;
-                            printf("Player %s moved teammate %s's token %d\n", 
-                                   player->color, teammate->color, i + 1);
-                            break;
+                    c->in[c->in_len] = '\0';
+                    c->in_len = 0;
+
+                    int a, b;
+                    char* line = c->in;
+                    if(c->sent_ns && ((sscanf(line, "ROLL %d %d", &a, &b) == 2 && a == c->seat) ||
+                                      strncmp(line, "STATE", 5) == 0 || strncmp(line, "MOVES", 5) == 0)) {
+                        if(num_samples == samples_cap) {
+                            long* grown = realloc(samples, 2 * samples_cap * sizeof(long));
+                            if(grown) {
+                                samples = grown;
+                                samples_cap *= 2;
+                            }
                         }
+                        if(num_samples < samples_cap) samples[num_samples++] = monotonic_ns() - c->sent_ns;
+                        c->sent_ns = 0;
+                    }
+
+                    if(sscanf(line, "SEAT %d %d", &a, &b) == 2) {
+                        c->seat = b;
+                    } else if(sscanf(line, "TURN %d", &a) == 1 && a == c->seat) {
+                        c->sent_ns = monotonic_ns();
+                        load_send(c, "ROLL\n");
+                        requests++;
+                    } else if(sscanf(line, "MOVES %d", &a) == 1) {
+                        char move[SERVER_LINE_MAX];
+                        snprintf(move, sizeof(move), "MOVE %d\n", a);
+                        c->sent_ns = monotonic_ns();
+                        load_send(c, move);
+                        requests++;
+                    } else if(sscanf(line, "OVER %d", &a) == 1) {
+                        if(c->seat == 0) {
+                            games++;
+                            turns += a;
+                        }
+                        c->seat = -1;
+                        load_send(c, join);
+                        requests++;
+                    } else if(strncmp(line, "ERR", 3) == 0) {
+                        errors++;
                     }
                 }
             }
-            
-            if(!moved) {
-                printf("Player %s couldn't move any token\n", player->color);
-                consecutive_unable_to_move++;
-                
-                if(consecutive_unable_to_move >= 10 && active_players <= 2) {
-                    printf("\nPlayer %s is stuck and cannot proceed. Game over.\n", player->color);
-                    player->is_active = false;
-                    player->rank = current_rank++;
-                    active_players--;
-                }
-            }
-            
-            display_board();
-            
-            if(check_win(player)) {
-            if(team_mode && teammate_id != -1) {
-                if(players[teammate_id].home_tokens == players[teammate_id].num_tokens) {
-                    // Both players have finished, end the game
-                    player->is_active = false;
-                    player->rank = current_rank++;
-                    active_players--;
-                    printf("\nBoth players in the team have finished!\n");
-                    continue_turn = false;
-                }
-            } else {
-                // Non-team mode or single player finished
-                player->is_active = false;
-                player->rank = current_rank++;
-                active_players--;
-                continue_turn = false;
-            }
-        }
-            
-            sem_post(&board_semaphore);
-            
-            // If it's not a 6 or player couldn't move, end turn
-            if(!moved || dice_value != 6) {
-                continue_turn = false;
-            } else {
-                printf("\nPlayer %s gets another turn for rolling a 6!\n", player->color);
+            if(got == 0) {
+                fprintf(stderr, "Server closed the connection\n");
+                lost = true;
             }
-            
-            usleep(500000);
         }
-        
-        previous_turn = player->id;
-        pthread_cond_broadcast(&turn_cond);
-        pthread_mutex_unlock(&turn_mutex);
-        
-        usleep(500000);
     }
+    double elapsed = now_seconds() - start;
+
+    qsort(samples, num_samples, sizeof(long), compare_long);
+    double p50 = num_samples ? samples[num_samples / 2] / 1e3 : 0.0;
+    double p99 = num_samples ? samples[(long)(num_samples * 0.99)] / 1e3 : 0.0;
+    double max = num_samples ? samples[num_samples - 1] / 1e3 : 0.0;
+
+    printf("%d connections, %d human seat%s per table: %ld games, %ld turns, %ld requests (%ld errors) in %.3f s\n",
+           clients, humans, humans == 1 ? "" : "s", games, turns, requests, errors, elapsed);
+    printf("%.0f turns/sec, %.0f requests/sec, round trip p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           elapsed > 0 ? turns / elapsed : 0.0, elapsed > 0 ? requests / elapsed : 0.0, p50, p99, max);
+
+    for(int i = 0; i < clients; i++) {
+        close(conns[i].fd);
+    }
+    close(epfd);
+    free(conns);
+    free(samples);
+    return errors || lost ? 1 : 0;
+}
+
+// Seats named in a comma separated list of colors, or "all"
+int parse_seats(const char* list, unsigned* seats) {
+    char buf[64];
     
-    return NULL;
+    snprintf(buf, sizeof(buf), "%s", list);
+    *seats = 0;
+    for(char* name = strtok(buf, ","); name; name = strtok(NULL, ",")) {
+        int found = -1;
+        for(int i = 0; i < NUM_PLAYERS; i++) {
+            if(strcasecmp(name, arm_colors[SEAT_ARM(i)]) == 0) found = i;
+        }
+        if(strcasecmp(name, "all") == 0) {
+            *seats = (1u << NUM_PLAYERS) - 1;
+        } else if(found >= 0) {
+            *seats |= 1u << found;
+        } else {
+            fprintf(stderr, "Unknown seat: %s\n", name);
+            return 1;
+        }
+    }
+    return 0;
 }
 
+// Rule variants named in a comma separated list, or "standard"
+int parse_rules(const char* list, uint8_t* rules) {
+    char buf[64];
+    
+    snprintf(buf, sizeof(buf), "%s", list);
+    *rules = 0;
+    for(char* name = strtok(buf, ","); name; name = strtok(NULL, ",")) {
+        int found = -1;
+        for(int i = 0; i < 3; i++) {
+            if(strcasecmp(name, rule_names[i]) == 0) found = i;
+        }
+        if(found >= 0) {
+            *rules |= 1u << found;
+        } else if(strcasecmp(name, "standard") != 0) {
+            fprintf(stderr, "Unknown rule: %s\n", name);
+            return 1;
+        }
+    }
+    return 0;
+}
 
+void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --headless        Simulate games without rendering, prompts or sleeps\n");
+    printf("  --games N         Number of headless games to play (default 1)\n");
+    printf("  --threads N       Worker threads for headless games (default: one per core)\n");
+    printf("  --seed N          Seed for the dice and turn order (default: time based)\n");
+    printf("  --tokens N        Tokens per player, 1-4 (default 4; asked for when interactive)\n");
+    printf("  --team            Play in team mode (asked for when interactive)\n");
+    printf("  --rules LIST      House rules: no-kill-gate, no-three-sixes, no-team-share (default standard)\n");
+    printf("  --max-turns N     Abandon a headless game after N turns (default 10000)\n");
+    printf("  --quiet           Only print the merged results\n");
+    printf("  --kernel NAME     Headless engine: simd (AVX2 batches of 8 games, default when supported) or scalar\n");
+    printf("  --tables N        Host N concurrent headless games on the worker threads, one roll at a time\n");
+    printf("  --checkpoint FILE Keep every hosted table's state in a memory-mapped FILE, updated after each turn\n");
+    printf("  --resume FILE     Continue the hosted tables saved in a checkpoint FILE\n");
+    printf("  --serve PATH      Run a game server on the Unix domain socket PATH\n");
+    printf("  --load PATH       Load-test the server at PATH until --games N games end (default 1000)\n");
+    printf("  --clients N       Connections opened by --load (default 1000)\n");
+    printf("  --humans N        Seats per table taken by --load connections, the rest are bots (default %d)\n", NUM_PLAYERS);
+    printf("  --record FILE     Write a binary replay of every game played (headless uses one thread)\n");
+    printf("  --replay FILE     Re-run the games in a replay log and check every move\n");
+    printf("  --events FILE     Append every game's events to a compressed event log\n");
+    printf("  --scan FILE       Read an event log and report what its games did (--threads sets the readers)\n");
+    printf("  --scheduler NAME  Turn scheduling for the interactive game: handoff (default) or broadcast\n");
+    printf("  --turn-delay MS   Pause after each roll of the interactive game (default 500) or a hosted table (default 0)\n");
+    printf("  --speed X         Clock rate for the pauses: 1 real time (default), 4 four times faster, 0.25 slow motion, 0 no pauses\n");
+    printf("  --ai SEATS        Let expectimax pick moves for these seats: red,yellow,green,blue or all\n");
+    printf("  --ai-depth N      Dice rolls the AI looks ahead (default 6)\n");
+    printf("  --ai-engine NAME  Search used by AI seats: expectimax (default) or mcts\n");
+    printf("  --ai-nodes N      Node budget per AI move, playouts for mcts (default: no limit)\n");
+    printf("  --ai-time MS      Time budget per AI move (default 100, 0 for no limit)\n");
+    printf("  --ai-threads N    Threads searching one mcts tree (default: one per core)\n");
+    printf("  --solve FILE      Solve the endgame duels exactly on --threads N threads and write a tablebase\n");
+    printf("  --tablebase FILE  Let AI seats look up endgame duels in a tablebase instead of searching them\n");
+    printf("  --analyze         Solve game length and turn-order odds for --tokens, --team and --rules as a Markov chain\n");
+    printf("  --bench           Run the benchmark suite (--games sets full games per config, default 20000)\n");
+    printf("  --bench-ops N     Calls per microbenchmark (default 4000000)\n");
+    printf("  --bench-format F  Benchmark output: text (default), json or csv\n");
+    printf("  --bench-out FILE  Write the benchmark results to FILE instead of stdout\n");
+    printf("  --help            Show this message\n");
+}
 
-int main() {
-    srand(time(NULL));
+int main(int argc, char* argv[]) {
+    bool headless = false;
+    int num_games = 1;
+    bool games_given = false;
+    int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int num_tokens = 4;
+    int max_turns = 10000;
+    uint64_t seed = (uint64_t)time(NULL);
+    bool seed_given = false;
+    bool quiet = false;
+    bool team = false;
+    bool tokens_given = false;
+    bool team_given = false;
+    bool broadcast = false;
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    const char* events_path = NULL;
+    const char* scan_path = NULL;
+    const char* solve_path = NULL;
+    const char* tablebase_path = NULL;
+    bool analyze = false;
+    bool simd_kernel = true;
+    int tables = 0;
+    const char* checkpoint_path = NULL;
+    const char* resume_path = NULL;
+    const char* serve_path = NULL;
+    const char* load_path = NULL;
+    int clients = 1000;
+    int humans = NUM_PLAYERS;
+    bool turn_delay_given = false;
+    bool bench = false;
+    long bench_ops = 4000000;
+    int bench_format = BENCH_TEXT;
+    const char* bench_out = NULL;
+    SearchConfig search = { 0, 6, 0, 100, SEARCH_EXPECTIMAX, (int)sysconf(_SC_NPROCESSORS_ONLN) };
+    
+    static struct option long_options[] = {
+        {"headless",  no_argument,       NULL, 'H'},
+        {"games",     required_argument, NULL, 'n'},
+        {"threads",   required_argument, NULL, 'j'},
+        {"seed",      required_argument, NULL, 's'},
+        {"tokens",    required_argument, NULL, 't'},
+        {"team",      no_argument,       NULL, 'T'},
+        {"rules",     required_argument, NULL, 'U'},
+        {"max-turns", required_argument, NULL, 'm'},
+        {"quiet",     no_argument,       NULL, 'q'},
+        {"scheduler", required_argument, NULL, 'S'},
+        {"record",    required_argument, NULL, 'r'},
+        {"replay",    required_argument, NULL, 'p'},
+        {"events",    required_argument, NULL, 'e'},
+        {"scan",      required_argument, NULL, 'Y'},
+        {"solve",     required_argument, NULL, 'v'},
+        {"tablebase", required_argument, NULL, 'B'},
+        {"analyze",   no_argument,       NULL, 'A'},
+        {"turn-delay", required_argument, NULL, 'd'},
+        {"speed",     required_argument, NULL, 'X'},
+        {"ai",        required_argument, NULL, 'a'},
+        {"ai-depth",  required_argument, NULL, 'D'},
+        {"ai-nodes",  required_argument, NULL, 'N'},
+        {"ai-time",   required_argument, NULL, 'M'},
+        {"ai-engine", required_argument, NULL, 'E'},
+        {"ai-threads", required_argument, NULL, 'J'},
+        {"kernel",    required_argument, NULL, 'K'},
+        {"tables",    required_argument, NULL, 'L'},
+        {"checkpoint", required_argument, NULL, 'C'},
+        {"resume",    required_argument, NULL, 'R'},
+        {"serve",     required_argument, NULL, 'V'},
+        {"load",      required_argument, NULL, 'l'},
+        {"clients",   required_argument, NULL, 'c'},
+        {"humans",    required_argument, NULL, 'u'},
+        {"bench",     no_argument,       NULL, 'b'},
+        {"bench-ops", required_argument, NULL, 'O'},
+        {"bench-format", required_argument, NULL, 'F'},
+        {"bench-out", required_argument, NULL, 'o'},
+        {"help",      no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    
+    int opt;
+    while((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch(opt) {
+            case 'H': headless = true; break;
+            case 'n': num_games = atoi(optarg); games_given = true; break;
+            case 'j': num_workers = atoi(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 0); seed_given = true; break;
+            case 't': num_tokens = atoi(optarg); tokens_given = true; break;
+            case 'T': team = true; team_given = true; break;
+            case 'U':
+                if(parse_rules(optarg, &game_rules) != 0) { print_usage(argv[0]); return 1; }
+                break;
+            case 'm': max_turns = atoi(optarg); break;
+            case 'q': quiet = true; break;
+            case 'S':
+                if(strcmp(optarg, "handoff") == 0) broadcast = false;
+                else if(strcmp(optarg, "broadcast") == 0) broadcast = true;
+                else { print_usage(argv[0]); return 1; }
+                break;
+            case 'r': record_path = optarg; break;
+            case 'p': replay_path = optarg; break;
+            case 'e': events_path = optarg; break;
+            case 'Y': scan_path = optarg; break;
+            case 'v': solve_path = optarg; break;
+            case 'B': tablebase_path = optarg; break;
+            case 'A': analyze = true; break;
+            case 'd': turn_delay_ticks = atol(optarg); turn_delay_given = true; break;
+            case 'X': game_clock.speed = atof(optarg); break;
+            case 'L': tables = atoi(optarg); break;
+            case 'C': checkpoint_path = optarg; break;
+            case 'R': resume_path = optarg; break;
+            case 'V': serve_path = optarg; break;
+            case 'l': load_path = optarg; break;
+            case 'c': clients = atoi(optarg); break;
+            case 'u': humans = atoi(optarg); break;
+            case 'a':
+                if(parse_seats(optarg, &search.players) != 0) { print_usage(argv[0]); return 1; }
+                break;
+            case 'D': search.max_depth = atoi(optarg); break;
+            case 'N': search.node_budget = atol(optarg); break;
+            case 'M': search.time_budget_ms = atoi(optarg); break;
+            case 'E':
+                if(strcmp(optarg, "expectimax") == 0) search.engine = SEARCH_EXPECTIMAX;
+                else if(strcmp(optarg, "mcts") == 0) search.engine = SEARCH_MCTS;
+                else { print_usage(argv[0]); return 1; }
+                break;
+            case 'J': search.threads = atoi(optarg); break;
+            case 'K':
+                if(strcmp(optarg, "simd") == 0) simd_kernel = true;
+                else if(strcmp(optarg, "scalar") == 0) simd_kernel = false;
+                else { print_usage(argv[0]); return 1; }
+                break;
+            case 'b': bench = true; break;
+            case 'O': bench_ops = atol(optarg); break;
+            case 'F':
+                if(strcmp(optarg, "text") == 0) bench_format = BENCH_TEXT;
+                else if(strcmp(optarg, "json") == 0) bench_format = BENCH_JSON;
+                else if(strcmp(optarg, "csv") == 0) bench_format = BENCH_CSV;
+                else { print_usage(argv[0]); return 1; }
+                break;
+            case 'o': bench_out = optarg; break;
+            case 'h': print_usage(argv[0]); return 0;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    
+    if(num_tokens < 1 || num_tokens > MAX_TOKENS) {
+        fprintf(stderr, "Invalid number of tokens: %d\n", num_tokens);
+        return 1;
+    }
+    if(game_clock.speed < 0.0 || turn_delay_ticks < 0) {
+        fprintf(stderr, "The clock speed and turn delay cannot be negative\n");
+        return 1;
+    }
+    if(team && !TEAM_PLAY) {
+        fprintf(stderr, "Team mode needs four seats; this build has %d\n", NUM_PLAYERS);
+        return 1;
+    }
+    
+    if(bench) {
+        if(bench_ops < 256 || (games_given && num_games < 1)) {
+            fprintf(stderr, "Benchmarks need --bench-ops of at least 256 and at least one game\n");
+            return 1;
+        }
+        // A fixed default seed and the standard rules keep runs comparable
+        game_rules = 0;
+        initialize_board();
+        return run_bench(bench_ops, games_given ? num_games : 20000, seed_given ? seed : 1, bench_format, bench_out);
+    }
+    
+    if(scan_path) {
+        return run_scan(scan_path, num_workers);
+    }
+    if(solve_path) {
+        initialize_board();
+        return run_solve(solve_path, num_workers > 0 ? num_workers : 1);
+    }
+    if(analyze) {
+        initialize_board();
+        return run_analysis(num_tokens, team, game_rules, num_workers > 0 ? num_workers : 1);
+    }
+    if(tablebase_path && tablebase_open(tablebase_path) != 0) return 1;
+    
+    if(tables < 0 || (tables > 0 && (record_path || events_path))) {
+        fprintf(stderr, "--tables needs a positive count and cannot be combined with --record or --events\n");
+        return 1;
+    }
+    
+    // A resumed run takes its settings from the checkpoint; games played before
+    // the checkpoint only survive in the totals, so there is no per-game listing
+    Checkpoint checkpoint;
+    if(resume_path) {
+        if(checkpoint_open(&checkpoint, resume_path) != 0) return 1;
+        headless = true;
+        quiet = true;
+        record_path = NULL;
+        events_path = NULL;
+        tables = checkpoint.header->tables;
+        num_games = checkpoint.header->num_games;
+        num_tokens = checkpoint.header->num_tokens;
+        team = checkpoint.header->team_mode;
+        game_rules = (uint8_t)checkpoint.header->rules;
+        max_turns = checkpoint.header->max_turns;
+        seed = checkpoint.header->seed;
+    } else if(checkpoint_path && !tables) {
+        fprintf(stderr, "--checkpoint needs --tables\n");
+        return 1;
+    }
+    
+    if(serve_path) {
+        initialize_board();
+        return run_server(serve_path, seed, max_turns);
+    }
+    if(load_path) {
+        if(clients < 1 || humans < 1 || humans > NUM_PLAYERS) {
+            fprintf(stderr, "--load needs at least one client and 1-%d humans per table\n", NUM_PLAYERS);
+            return 1;
+        }
+        return run_load(load_path, clients, games_given ? num_games : 1000, num_tokens, team, humans);
+    }
+    
+    if(replay_path) {
+        initialize_board();
+        return run_replay(replay_path, quiet);
+    }
+    
+    Replay replay;
+    EventLog events;
+    memset(&replay, 0, sizeof(replay));
+    if(record_path) {
+        replay.out = fopen(record_path, "wb");
+        if(!replay.out) {
+            perror(record_path);
+            return 1;
+        }
+    }
+    
+    if(headless) {
+        if(num_workers < 1 || record_path) num_workers = 1;
+        if(num_workers > num_games && num_games > 0) num_workers = num_games;
+        if(tables > num_games) tables = num_games;
+        if(tables > 0 && num_workers > tables) num_workers = tables;
+        // Hosted tables only pause between rolls when asked to
+        if(tables > 0 && !turn_delay_given) turn_delay_ticks = 0;
+        
+        initialize_board();
+        if(checkpoint_path && !resume_path &&
+           checkpoint_create(&checkpoint, checkpoint_path, tables, num_games, num_tokens, team, max_turns, seed) != 0) {
+            return 1;
+        }
+        bool checkpointed = resume_path || checkpoint_path;
+        if(events_path && event_log_open(&events, events_path, num_workers) != 0) return 1;
+        
+        // The batched kernel plays the built-in bot under the standard rules only and does not record
+        bool batched = simd_kernel && !tables && !record_path && !events_path && !search.players &&
+                       !game_rules && batch_kernel_available();
+        int status = run_tournament(num_games, num_workers, num_tokens, team, max_turns, seed, quiet,
+                                    record_path ? &replay : NULL, events_path ? &events : NULL,
+                                    search.players ? &search : NULL, batched, tables,
+                                    checkpointed ? &checkpoint : NULL);
+        if(record_path) fclose(replay.out);
+        if(events_path) event_log_close(&events);
+        if(checkpointed) checkpoint_close(&checkpoint);
+        return status;
+    }
+    
+    Game* game = &live_game;
+    game->verbose = true;
+    game->shared = true;
     
     sem_init(&dice_semaphore, 0, 1);
     sem_init(&board_semaphore, 0, 1);
     
     initialize_board();
-    initialize_players();
-    initialize_teams();
+    if(tokens_given) {
+        game->num_tokens_per_player = num_tokens;
+    } else {
+        initialize_players(game);
+    }
+    if(team_given) {
+        setup_teams(game);
+    } else {
+        initialize_teams(game);
+    }
+    reset_game(game, seed);
+    SearchArena arena;
+    memset(&arena, 0, sizeof(arena));
+    if(search.players) {
+        game->search = &search;
+        game->choose_move = search_move;
+        game->arena = &arena;
+    }
+    if(record_path) {
+        game->replay = &replay;
+        replay_begin_game(&replay, game, seed);
+    }
+    if(events_path) {
+        if(event_log_open(&events, events_path, 1) != 0) return 1;
+        game->events = &events.streams[0];
+        event_begin_game(game, 0, seed);
+    }
     
     printf("\nInitial Ludo Board State:\n");
-    display_board();
+    display_board(game);
     
     printf("\nBoard Legend:\n");
     printf("\033[1;31m█ \033[0m- Red Home\n");
@@ -761,47 +6598,68 @@ int main() {
     printf("\033[1;37m* \033[0m- Safe Square\n");
     printf("□ - Path\n");
     
-    printf("\nStarting game with %d tokens per player\n", num_tokens_per_player);
+    printf("\nStarting game with %d tokens per player\n", game->num_tokens_per_player);
     
-    // Create player threads with random order
-    int thread_order[NUM_PLAYERS] = {0, 1, 2, 3};
-    for(int i = NUM_PLAYERS - 1; i > 0; i--) {
-        int j = rand() % (i + 1);
-        int temp = thread_order[i];
-        thread_order[i] = thread_order[j];
-        thread_order[j] = temp;
-    }
+    long switches_at_start = context_switches();
+    sem_init(&scheduler.game_over, 0, 0);
+    console_start();
+    clock_start(&game_clock);
     
-    printf("\nPlayer order: ");
-    for(int i = 0; i < NUM_PLAYERS; i++) {
-        printf("%s ", players[thread_order[i]].color);
-        pthread_create(&players[thread_order[i]].thread_id, NULL, 
-                      player_turn, &players[thread_order[i]]);
+    if(broadcast) {
+        // Create player threads with random order
+        int thread_order[NUM_PLAYERS];
+        for(int i = 0; i < NUM_PLAYERS; i++) thread_order[i] = i;
+        for(int i = NUM_PLAYERS - 1; i > 0; i--) {
+            int j = rng_below(&game->rng, i + 1);
+            int temp = thread_order[i];
+            thread_order[i] = thread_order[j];
+            thread_order[j] = temp;
+        }
+        
+        console_printf("\nPlayer order: ");
+        for(int i = 0; i < NUM_PLAYERS; i++) {
+            console_printf("%s ", game->players[thread_order[i]].color);
+            pthread_create(&game->players[thread_order[i]].thread_id, NULL, 
+                          player_turn_broadcast, &game->players[thread_order[i]]);
+        }
+        console_printf("\n");
+    } else {
+        for(int i = 0; i < NUM_PLAYERS; i++) {
+            sem_init(&scheduler.slot[i], 0, 0);
+            scheduler.order[i] = i;
+            pthread_create(&game->players[i].thread_id, NULL, player_turn, &game->players[i]);
+        }
+        start_round(game);
+        sem_post(&scheduler.slot[scheduler.order[0]]);
     }
-    printf("\n");
     
-    // Wait for game to complete
-    while(active_players > 1) {
-        usleep(100000);
-    }
+    // Wait for the turn that ends the game
+    while(sem_wait(&scheduler.game_over) != 0);
+    
+    long switches = context_switches() - switches_at_start;
+    console_stop();
+    
+    if(record_path || events_path) record_game_end(game);
+    if(record_path) fclose(replay.out);
     
     // Display final results
+    close_display();
     printf("\n=== Game Over ===\n");
     
-    if (team_mode) {
+    if (game->team_mode) {
         TeamResult team_results[2];
         
         // Initialize team results
         for (int i = 0; i < 2; i++) {
             team_results[i].team_number = i + 1;
-            strcpy(team_results[i].player1_color, players[teams[i].player1_id].color);
-            strcpy(team_results[i].player2_color, players[teams[i].player2_id].color);
-            team_results[i].total_hits = players[teams[i].player1_id].hit_record + 
-                                       players[teams[i].player2_id].hit_record;
+            strcpy(team_results[i].player1_color, game->players[game->teams[i].player1_id].color);
+            strcpy(team_results[i].player2_color, game->players[game->teams[i].player2_id].color);
+            team_results[i].total_hits = game->players[game->teams[i].player1_id].hit_record + 
+                                       game->players[game->teams[i].player2_id].hit_record;
             
             // Calculate team rank based on player ranks
-            int player1_rank = players[teams[i].player1_id].rank;
-            int player2_rank = players[teams[i].player2_id].rank;
+            int player1_rank = game->players[game->teams[i].player1_id].rank;
+            int player2_rank = game->players[game->teams[i].player2_id].rank;
             team_results[i].rank = (player1_rank < player2_rank) ? player1_rank : player2_rank;
         }
         
@@ -828,46 +6686,68 @@ int main() {
             
             // Show individual player stats
             printf("  Individual Stats:\n");
-            int p1_id = teams[i].player1_id;
-            int p2_id = teams[i].player2_id;
+            int p1_id = game->teams[i].player1_id;
+            int p2_id = game->teams[i].player2_id;
             printf("    %s: %d hits (Rank: %d)\n", 
-                   players[p1_id].color, 
-                   players[p1_id].hit_record,
-                   players[p1_id].rank);
+                   game->players[p1_id].color, 
+                   game->players[p1_id].hit_record,
+                   game->players[p1_id].rank);
             printf("    %s: %d hits (Rank: %d)\n", 
-                   players[p2_id].color, 
-                   players[p2_id].hit_record,
-                   players[p2_id].rank);
+                   game->players[p2_id].color, 
+                   game->players[p2_id].hit_record,
+                   game->players[p2_id].rank);
         }
     } else {
         printf("\nFinal Rankings:\n");
         for(int rank = 1; rank <= NUM_PLAYERS; rank++) {
             for(int i = 0; i < NUM_PLAYERS; i++) {
-                if(players[i].rank == rank) {
+                if(game->players[i].rank == rank) {
                     printf("%d. %s (Hit rate: %d)\n", 
-                           rank, players[i].color, players[i].hit_record);
+                           rank, game->players[i].color, game->players[i].hit_record);
                     break;
                 }
             }
         }
     }
     
+    int turns = game->turn_count > 0 ? game->turn_count : 1;
+    printf("\nTurn scheduling (%s): %d turns, %ld thread wakeups (%.2f per turn), "
+           "%ld context switches (%.2f per turn)\n",
+           broadcast ? "broadcast" : "handoff", game->turn_count,
+           scheduler.wakeups, (double)scheduler.wakeups / turns,
+           switches, (double)switches / turns);
+    printf("Console: %ld frames drawn, %ld dropped, %ld lines dropped\n", console.frames_drawn,
+           atomic_load(&console.frames_dropped), atomic_load(&console.lines_dropped));
+    if(game->search) print_search_stats(game->search, &game->search_stats);
+    if(events_path) event_log_close(&events);
+#ifdef LUDO_INSTRUMENT
+    printf("\nInstrumentation:\n");
+    print_instrumentation(stdout, broadcast ? "broadcast" : "handoff");
+#endif
+    
     printf("\nCancelling remaining threads...\n");
     for(int i = 0; i < NUM_PLAYERS; i++) {
-        if(players[i].is_active) {
-            pthread_cancel(players[i].thread_id);
+        if(game->players[i].is_active) {
+            pthread_cancel(game->players[i].thread_id);
             printf("Cancelled thread for player %s (ID: %lu)\n", 
-                   players[i].color, (unsigned long)players[i].thread_id);
+                   game->players[i].color, (unsigned long)game->players[i].thread_id);
         }
     }
     
     // Clean up resources
+    search_arena_release(&arena);
     sem_destroy(&dice_semaphore);
     sem_destroy(&board_semaphore);
     pthread_mutex_destroy(&board_mutex);
     pthread_mutex_destroy(&dice_mutex);
     pthread_mutex_destroy(&turn_mutex);
     pthread_cond_destroy(&turn_cond);
+    sem_destroy(&scheduler.game_over);
+    if(!broadcast) {
+        for(int i = 0; i < NUM_PLAYERS; i++) {
+            sem_destroy(&scheduler.slot[i]);
+        }
+    }
     
     return 0;
 }
\ No newline at end of file